@@ -0,0 +1,347 @@
+# coding=utf-8
+"""
+  Self-contained benchmark of the bound entry points.
+
+  Inputs are generated deterministically (rendered text lines, ruled IB-like
+  table, UB04-like page) so no external data is needed apart from the OCR
+  models/configs used by `get_i2t`. Entry points that need an OCR'd document
+  (document json, detect_columns, create_report, process_ib) use `--doc` when
+  given, otherwise a document generated by OCRing a synthetic ruled table.
+
+  Usage: python bench_i2t.py [--repeat 20] [--doc doc.json] [--workers 4] [--out result.json]
+"""
+import argparse
+import difflib
+import json
+import os
+import sys
+import time
+
+_this_dir = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(_this_dir, "../unittests"))
+
+import numpy as np
+
+from testhelpers import _WORDS, get_i2t, ruled_table, synthetic_doc_json
+
+
+# =================
+# synthetic inputs
+
+def _rng(seed):
+    return np.random.RandomState(seed)
+
+
+def _put_text(img, text, x, y, scale=0.9, thickness=2):
+    import cv2
+    cv2.putText(img, text, (x, y), cv2.FONT_HERSHEY_SIMPLEX,
+                scale, 0, thickness, cv2.LINE_AA)
+
+
+def text_line(seed, words=6, scale=0.9):
+    """ Gray line image with `words` words, returns (img, word_bboxes). """
+    import cv2
+    rng = _rng(seed)
+    chosen = [_WORDS[i] for i in rng.randint(0, len(_WORDS), size=words)]
+    h = int(40 * scale) + 20
+    x, bboxes, parts = 10, [], []
+    for w in chosen:
+        (tw, th), base = cv2.getTextSize(w, cv2.FONT_HERSHEY_SIMPLEX, scale, 2)
+        bboxes.append((x, 10, x + tw, 10 + th + base))
+        parts.append((w, x))
+        x += tw + int(20 * scale)
+    img = np.full((h, x + 10), 255, dtype=np.uint8)
+    for w, wx in parts:
+        _put_text(img, w, wx, 10 + int(30 * scale), scale)
+    return img, bboxes, ' '.join(chosen)
+
+
+def ib_table(seed, rows=30, cols=5, cell_w=260, cell_h=48):
+    """ `ruled_table` with the bboxes of its cells, returns (img, word_bboxes). """
+    img, row_bboxes = ruled_table(seed, rows, cols, cell_w, cell_h)
+    bboxes = []
+    for _, y0, _, y1 in row_bboxes:
+        for c in range(cols):
+            x = 30 + c * cell_w
+            bboxes.append((x, y0, x + cell_w - 20, y1))
+    return img, bboxes
+
+
+def ub04_page(seed):
+    """ UB04-like page - boxed header fields above a ruled service line table. """
+    rng = _rng(seed)
+    page = np.full((3300, 2550), 255, dtype=np.uint8)
+    for i in range(12):
+        x, y = 100 + (i % 4) * 580, 120 + (i // 4) * 140
+        page[y:y + 2, x:x + 540] = 0
+        page[y + 110:y + 112, x:x + 540] = 0
+        page[y:y + 112, x:x + 2] = 0
+        page[y:y + 112, x + 538:x + 540] = 0
+        _put_text(page, _WORDS[rng.randint(0, len(_WORDS))], x + 20, y + 70)
+    table, _ = ib_table(seed + 1, rows=22, cols=8, cell_w=290, cell_h=60)
+    page[600:600 + table.shape[0], 50:50 + table.shape[1]] = table
+    return page
+
+
+# =================
+# measuring
+
+def peak_rss_mb():
+    try:
+        import resource
+    except ImportError:
+        return None
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # bytes on mac, kilobytes on linux
+    return rss / (1024. * 1024.) if sys.platform == 'darwin' else rss / 1024.
+
+
+def smaps_rollup_mb():
+    """ Rss, Pss and Private memory of this process [MB] (linux only). """
+    res = {"Rss": 0., "Pss": 0., "Private": 0.}
+    with open('/proc/self/smaps_rollup', mode='r') as fin:
+        for line in fin:
+            k, _, v = line.partition(':')
+            k = 'Private' if k.startswith('Private_') else k
+            if k in res:
+                res[k] += int(v.split()[0]) / 1024.
+    return res
+
+
+def worker_memory(m, workers):
+    """
+        Fork `workers` children after `m.prefork()` like a pre-fork server, each
+        OCRs a line and reports its memory through a pipe while all of them are
+        alive. `Private` is what every additional worker costs.
+    """
+    if not hasattr(os, 'fork') or not os.path.exists('/proc/self/smaps_rollup'):
+        return None
+    m.prefork()
+    line, _, _ = text_line(1)
+    go_r, go_w = os.pipe()
+    children = []
+    for _ in range(workers):
+        r, w = os.pipe()
+        pid = os.fork()
+        if 0 == pid:
+            code = 1
+            try:
+                os.close(r)
+                os.close(go_w)
+                if m.t3 is not None:
+                    m._impl.ocr_line(m.t3, m._impl.image(line), False)
+                os.write(w, json.dumps(smaps_rollup_mb()).encode('utf-8'))
+                os.close(w)
+                # stay alive (sharing pages) until every worker reported
+                os.read(go_r, 1)
+                code = 0
+            finally:
+                os._exit(code)
+        os.close(w)
+        children.append((pid, r))
+
+    res = []
+    for pid, r in children:
+        with os.fdopen(r, 'rb') as fin:
+            data = fin.read()
+        if data:
+            res.append(json.loads(data.decode('utf-8')))
+    os.close(go_w)
+    for pid, _ in children:
+        os.waitpid(pid, 0)
+    os.close(go_r)
+    return {"parent": smaps_rollup_mb(), "workers": res}
+
+
+def cold_start(m, repeat=3):
+    """
+        Engine startup of a new engine manager: the previous python path (json
+        load, env built key by key with `str()`, `init` per engine) vs
+        `init_all` reading the config natively.
+    """
+    impl, dirs = m._impl, m._dirs
+    if dirs is None:
+        return None
+    conf = os.path.join(dirs.configs, 'maz.v5.json')
+
+    def python_path():
+        with open(conf, mode='r') as fin:
+            ocr_js = json.load(fin)['ocr-params']
+        oem = impl.ocr_engine_manager('tesseract3', 'tesseract4')
+        env3 = impl.env()
+        for k, v in ocr_js['default'].items():
+            env3[k] = str(v)
+        env4 = impl.env()
+        for k, v in ocr_js['reocr'].items():
+            env4[k] = str(v)
+        oem.ocr().init(dirs.lang, 'maz', env3)
+        oem.reocr().init(dirs.lang, 'maz-lstm', env4)
+
+    def native_path():
+        oem = impl.ocr_engine_manager('tesseract3', 'tesseract4')
+        oem.init_all(conf, dirs.lang, 'maz', 'maz-lstm')
+
+    before = measure('cold_start_python', lambda _: python_path(), repeat)
+    after = measure('cold_start_init_all', lambda _: native_path(), repeat)
+    return {"python": before, "init_all": after,
+            "speedup": before["mean_s"] / after["mean_s"] if after["mean_s"] > 0 else None}
+
+
+def measure(name, func, repeat, setup=None, items=1):
+    """ Time `func(setup())` `repeat` times, setup is excluded. """
+    lat = []
+    for _ in range(repeat):
+        arg = setup() if setup is not None else None
+        s = time.perf_counter()
+        func(arg)
+        lat.append(time.perf_counter() - s)
+    lat = np.array(lat)
+    return {
+        "name": name,
+        "repeat": repeat,
+        "items_per_call": items,
+        "throughput_items_s": items * repeat / lat.sum() if lat.sum() > 0 else None,
+        "mean_s": float(lat.mean()),
+        "p50_s": float(np.percentile(lat, 50)),
+        "p90_s": float(np.percentile(lat, 90)),
+        "p99_s": float(np.percentile(lat, 99)),
+        "max_s": float(lat.max()),
+    }
+
+
+# =================
+
+def run(m, repeat, doc_file=None):
+    impl = m._impl
+    results, skipped = [], {}
+
+    line, line_bboxes, _ = text_line(1)
+    word = line[:, line_bboxes[0][0] - 5:line_bboxes[0][2] + 5]
+    block = np.vstack([text_line(i)[0][:, :600] for i in range(2, 8)])
+    table, table_bboxes = ib_table(3)
+    page = ub04_page(4)
+
+    def img(arr):
+        return lambda: impl.image(arr)
+
+    # ocr
+    conf_range = {}
+    for label, engine in (('v3', m.t3), ('v4', m.t4)):
+        if engine is None:
+            skipped['ocr_%s' % label] = 'OCR models not loaded'
+            continue
+        results.append(measure('ocr_line_' + label, lambda i: impl.ocr_line(engine, i, False), repeat, img(line)))
+        # the cascade divides confidences by a fixed per engine scale, show what they report
+        confs = [w.conf() for w in impl.ocr_line(engine, impl.image(line), False)[1]]
+        conf_range[label] = {"min": min(confs), "max": max(confs)} if confs else None
+        results[-1]['conf_range'] = conf_range[label]
+        results.append(measure('ocr_word_' + label, lambda i: impl.ocr_word(engine, i), repeat, img(word)))
+        results.append(measure('ocr_block_' + label, lambda i: impl.ocr_block(engine, i), max(1, repeat // 4), img(block)))
+
+    # resolution normalization - speed vs accuracy on a large (600 DPI like) line
+    if m.t3 is not None:
+        big_line, _, truth = text_line(5, scale=3.0)
+        for target in (0, 24, 12):
+            r = measure('ocr_line_letter_h_%d' % target,
+                        lambda i, t=target: impl.ocr_line(m.t3, i, False, target_letter_h=t),
+                        max(1, repeat // 4), img(big_line))
+            s, _ = impl.ocr_line(m.t3, impl.image(big_line), False, target_letter_h=target)
+            r['accuracy'] = difflib.SequenceMatcher(None, s.strip(), truth).ratio()
+            results.append(r)
+
+    if m.oem is not None:
+        impl.ocr_cascade_stats_reset()
+        results.append(measure('ocr_cascade', lambda i: impl.ocr_cascade(m.oem, i, 0.7), repeat, img(line)))
+        results[-1]['cascade'] = impl.ocr_cascade_stats()
+
+    if m.t4 is not None:
+        table_img = impl.image(table)
+        bboxes = [impl.bbox_type(*b) for b in table_bboxes[:40]]
+        results.append(measure('reocr', lambda _: [impl.reocr(m.t4, table_img, b, False) for b in bboxes],
+                               max(1, repeat // 4), items=len(bboxes)))
+        results.append(measure('reocr_many', lambda _: impl.reocr_many(m.t4, table_img, bboxes),
+                               max(1, repeat // 4), items=len(bboxes)))
+
+    # image analysis / ops
+    results.append(measure('ia_lines', lambda i: impl.ia_lines(i, 30, ''), repeat, img(table)))
+    results.append(measure('ia_lines_ub04', lambda i: impl.ia_lines(i, 30, ''), max(1, repeat // 4), img(page)))
+    table_roi = impl.bbox_type(50, 600, 2410, 1960)  # ruled table of ub04_page
+    results.append(measure('ia_lines_ub04_roi', lambda i: impl.ia_lines(i, 30, '', table_roi), max(1, repeat // 4), img(page)))
+    results.append(measure('ia_lines_many', lambda imgs: impl.ia_lines_many(imgs, 30),
+                           max(1, repeat // 4), lambda: [impl.image(page) for _ in range(4)], items=4))
+    for op in ('binarize_otsu', 'binarize_sauvola', 'deskew', 'downscale2x', 'to8bpp'):
+        results.append(measure(op, lambda i, op=op: getattr(i, op)(), repeat, img(page)))
+    pages = lambda: [impl.image(page) for _ in range(4)]
+    results.append(measure('image_ops_many', lambda imgs: impl.image_ops_many(imgs, ['to8bpp', 'binarize_sauvola']),
+                           max(1, repeat // 4), pages, items=4))
+
+    ub_templ = os.path.join(m._dirs.configs, 'ub04-bbox-template.json') if m._dirs else ''
+    if os.path.exists(ub_templ):
+        results.append(measure('ub04_form.classify', lambda i: impl.ub04_form.classify(i, ub_templ, True),
+                               max(1, repeat // 4), img(page)))
+    else:
+        skipped['ub04_form.classify'] = 'missing ub04-bbox-template.json'
+
+    # document based - generated from the OCRed synthetic table unless `--doc` is given
+    doc_table = table
+    if doc_file is not None:
+        with open(doc_file, mode='r', encoding='utf-8') as fin:
+            js_str = fin.read()
+    elif m.t3 is not None:
+        js_str, doc_table = synthetic_doc_json(m)
+    else:
+        js_str = None
+    if js_str is None:
+        for k in ('document.from_str', 'document.to_json_str', 'detect_columns', 'create_report', 'process_ib'):
+            skipped[k] = 'needs --doc or OCR models'
+    else:
+        results.append(measure('document.from_str', lambda _: m.load_doc(js_str), repeat))
+        doc = m.load_doc(js_str)
+        results.append(measure('document.to_json_str', lambda _: doc.to_json_str(), repeat))
+        p = doc.last_page()
+        imgb = impl.image(doc_table)
+        imgb.binarize_otsu()
+        grid = m.create_grid_info(p)
+        results.append(measure('detect_columns', lambda _: impl.detect_columns(p, imgb, grid), repeat))
+        cols = impl.create_columns(p)
+        results.append(measure('create_report', lambda _: m.create_report(doc, cols, grid, imgb), repeat))
+        tpl = m.load_ib_form_template(doc)
+        results.append(measure('create_report_template', lambda _: m.create_report(doc, cols, grid, imgb, template=tpl), repeat))
+        results.append(measure('process_ib', lambda _: m.process_ib(doc, imgb, grid), max(1, repeat // 4)))
+
+    return {
+        "version": m.version(),
+        "repeat": repeat,
+        "results": results,
+        "skipped": skipped,
+        "startup_timing": m.startup_timing,
+        "cold_start": cold_start(m),
+        "native_metrics": impl.metrics(),
+        "peak_rss_mb": peak_rss_mb(),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--repeat', type=int, default=20)
+    parser.add_argument('--doc', default=None, help='document json for document based entry points (default: generated)')
+    parser.add_argument('--out', default=None, help='write json result here instead of stdout')
+    parser.add_argument('--workers', type=int, default=4, help='forked workers for the per worker memory (0 - off)')
+    args = parser.parse_args()
+
+    m = get_i2t()
+    m._impl.metrics_reset()
+    res = run(m, args.repeat, args.doc)
+    if 0 < args.workers:
+        res["worker_memory_mb"] = worker_memory(m, args.workers)
+
+    js = json.dumps(res, indent=2)
+    if args.out:
+        with open(args.out, mode='w', encoding='utf-8') as fout:
+            fout.write(js)
+    else:
+        print(js)
+
+
+if __name__ == '__main__':
+    main()
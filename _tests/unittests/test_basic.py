@@ -36,6 +36,7 @@ class Test_basic(unittest.TestCase):
             val = m.subtypes_dict(inp)
             print(val)
             self.assertEqual(val, exp)
+            self.assertEqual(val, json.loads(m._impl.json_subtypes_s(inp)))
 
     def test_ocr3(self):
         """ test_version """
@@ -69,6 +70,303 @@ class Test_basic(unittest.TestCase):
         print(' '.join('[%s:%s:%s] ' % (w.conf(), w.text, w.bbox)
                        for w in words))
 
+    def test_ocr_params(self):
+        """ test_ocr_params - native config values equal python str() of json.load """
+        import tempfile
+        m = get_i2t()
+
+        values = '{"f1": 0.1, "f2": 1e-05, "f3": 1e16, "f4": -0.0, "f5": 1.5e-7, "f6": 123456789.125, ' \
+                 '"f7": 2.0, "b1": true, "b2": false, "n": null, "i": -42, "s": "eng+osd"}'
+        with tempfile.TemporaryDirectory() as tmp:
+            f = os.path.join(tmp, 'conf.json')
+
+            def write(default):
+                with open(f, mode='w', encoding='utf-8') as fout:
+                    fout.write('{"ocr-params": {"default": %s, "reocr": {"x": 1}}}' % default)
+
+            write(values)
+            default, reocr = m._impl.ocr_params(f)
+            self.assertEqual({k: str(v) for k, v in json.loads(values).items()}, default)
+            self.assertEqual({'x': '1'}, reocr)
+
+            # containers are not engine parameters
+            for container in ('[1, 2]', '{"a": 1}'):
+                write('{"bad": %s}' % container)
+                with self.assertRaises(ValueError):
+                    m._impl.ocr_params(f)
+
+    def test_image_from_array(self):
+        """ test_image_from_array """
+        import numpy as np
+        m = get_i2t()
+
+        gray = (np.arange(7 * 13, dtype=np.uint8) * 3).reshape(7, 13)
+        img = m._impl.image(gray)
+        self.assertEqual(img.bbox().width(), 13)
+        self.assertTrue((img.to_array() == gray).all())
+
+        bgr = np.dstack([gray, gray // 2, 255 - gray])
+        img = m._impl.image(bgr)
+        self.assertTrue((img.to_array() == bgr).all())
+        # non-contiguous view
+        img = m._impl.image(bgr[:, ::2])
+        self.assertTrue((img.to_array() == bgr[:, ::2]).all())
+
+        packed = np.packbits(gray > 100, axis=1)
+        img = m._impl.image(packed, bpp=1, width=13)
+        self.assertTrue(img.is_binary())
+        self.assertTrue((img.to_array() == packed).all())
+
+        # raster owns its pixels - valid after the image is gone
+        img = m._impl.image(gray)
+        raster = img.raster()
+        self.assertEqual(raster.dtype, np.uint32)
+        self.assertEqual(raster.shape[0], 7)
+        del img
+        self.assertEqual(raster.copy().shape[0], 7)
+
+    def test_image_from_bytes(self):
+        """ test_image_from_bytes """
+        import cv2
+        import numpy as np
+        m = get_i2t()
+
+        gray = (np.arange(17 * 23, dtype=np.uint8) * 5).reshape(17, 23)
+        png = cv2.imencode('.png', gray)[1].tobytes()
+        for buf in (png, bytearray(png), memoryview(png)):
+            img = m._impl.image.from_bytes(buf, 'image/png')
+            self.assertTrue((img.to_array() == gray).all())
+        self.assertTrue((m.create_image_from_bytes(png).to_array() == gray).all())
+
+        with self.assertRaises(ValueError):
+            m._impl.image.from_bytes(png, 'image/jpeg')
+        for short in (b'', png[:11]):
+            with self.assertRaises(ValueError):
+                m._impl.image.from_bytes(short, 'png')
+            with self.assertRaises(ValueError):
+                m._impl.image.from_bytes(short, '')
+        # strided buffers are not read linearly
+        strided = np.frombuffer(png + png, dtype=np.uint8)[::2]
+        with self.assertRaises(ValueError):
+            m._impl.image.from_bytes(memoryview(strided), 'png')
+
+    def test_image_reader(self):
+        """ test_image_reader - multi-page tiff pages counted from the IFDs """
+        import tempfile
+        import cv2
+        import numpy as np
+        m = get_i2t()
+
+        pages = [np.full((9 + i, 11), 40 * i, dtype=np.uint8) for i in range(3)]
+        with tempfile.TemporaryDirectory() as tmp:
+            f = os.path.join(tmp, 'pages.tif')
+            self.assertTrue(cv2.imwritemulti(f, pages))
+            reader = m.image_pages(f)
+            self.assertEqual(len(reader), 3)
+            for i, img in enumerate(reader):
+                self.assertTrue((img.to_array() == pages[i]).all())
+            self.assertTrue((reader[-1].to_array() == pages[2]).all())
+            self.assertTrue((reader[-3].to_array() == pages[0]).all())
+            for i in (3, -4):
+                with self.assertRaises(IndexError):
+                    reader[i]
+
+            f = os.path.join(tmp, 'page.png')
+            self.assertTrue(cv2.imwrite(f, pages[1]))
+            self.assertEqual(len(m.image_pages(f)), 1)
+
+    def test_page_image(self):
+        """ test_page_image - stored page images decoded to bytes and image """
+        import base64
+        import cv2
+        m = get_i2t()
+
+        js_str, table = testhelpers.synthetic_doc_json(m, rows=2, cols=2)
+        png = cv2.imencode('.png', table)[1].tobytes()
+        js = json.loads(js_str)
+        js['pages'][0]['images'] = {'orig': base64.b64encode(png).decode('ascii')}
+        doc = m._impl.document(m._impl.env())
+        doc.from_str(json.dumps(js))
+        page = doc.last_page()
+
+        self.assertFalse(page.has_image('missing'))
+        with self.assertRaises(KeyError):
+            page.image_bytes('missing')
+        with self.assertRaises(KeyError):
+            page.image('missing')
+        if not page.has_image('orig'):
+            self.skipTest('page images are not stored under `images`')
+        self.assertEqual(page.image_bytes('orig'), png)
+        self.assertEqual(page.image_bytes('orig'), base64.b64decode(page.image_data_png_base64('orig')))
+        self.assertTrue((page.image('orig').to_array() == table).all())
+
+    def test_ocr_cascade(self):
+        """ test_ocr_cascade - low confidence words are reOCRed and counted """
+        m = get_i2t()
+        impl = m._impl
+        table, row_bboxes = testhelpers.ruled_table(rows=1, cols=4)
+        x0, y0, x1, y1 = row_bboxes[0]
+        img = impl.image(table[y0:y1, x0:x1].copy())
+        _, fast_words = impl.ocr_line(m.t3, img, False)
+        n = len(fast_words)
+        self.assertTrue(0 < n)
+
+        # above any confidence - every word goes to reOCR
+        impl.ocr_cascade_stats_reset()
+        s, words = impl.ocr_cascade(m.oem, img, 1.01, False)
+        stats = impl.ocr_cascade_stats()
+        self.assertEqual(1, stats['lines'])
+        self.assertEqual(n, stats['words'])
+        self.assertEqual(n, stats['low_conf'])
+        self.assertEqual(n, stats['reocr_words'])
+        self.assertEqual(0, stats['reocr_avoided'])
+        self.assertTrue(stats['replaced'] <= n)
+        self.assertEqual(n, len(words))
+        self.assertEqual(s, ' '.join(w.text for w in words))
+        for fw, w in zip(fast_words, words):
+            _, re_words = impl.reocr(m.t4, img, fw.bbox, False)
+            self.assertIn(w.text, (fw.text, ' '.join(rw.text for rw in re_words)))
+            if w.text != fw.text:
+                # a replaced word keeps the fast engine's scale
+                self.assertTrue(fw.conf() < w.conf())
+
+        # a percent scale engine on a bad line (every conf <= 1) is still reOCRed
+        impl.ocr_cascade_stats_reset()
+        impl.ocr_cascade(m.oem, img, 0.7, False, fast_scale=1e6)
+        self.assertEqual(n, impl.ocr_cascade_stats()['low_conf'])
+
+        # below any confidence - nothing is reOCRed
+        impl.ocr_cascade_stats_reset()
+        s, words = impl.ocr_cascade(m.oem, img, 0., False)
+        stats = impl.ocr_cascade_stats()
+        self.assertEqual(0, stats['reocr_words'])
+        self.assertEqual(n, stats['reocr_avoided'])
+        self.assertEqual([w.text for w in fast_words], [w.text for w in words])
+
+        with self.assertRaises(ValueError):
+            impl.ocr_cascade(m.oem, img, 0.7, False, fast_scale=0.)
+
+    def test_line_indexing(self):
+        """ test_line_indexing - iteration, negative and O(1) indexing of line words """
+        m = get_i2t()
+        doc = m.load_doc(testhelpers.synthetic_doc_json(m, rows=2, cols=4)[0])
+        line = doc.last_page().lines()[0]
+        n = len(line)
+        self.assertTrue(1 < n)
+
+        expected = [w.text for w in line.words()]
+        self.assertEqual(expected, [w.text for w in line])
+        self.assertEqual(expected, [line[i].text for i in range(n)])
+        self.assertEqual(expected, [line[i - n].text for i in range(n)])
+        idx = line.indexed()
+        self.assertEqual(n, len(idx))
+        self.assertEqual(expected, [idx[i].text for i in range(n)])
+        self.assertEqual(expected[-1], idx[-1].text)
+        for i in (n, -n - 1):
+            with self.assertRaises(IndexError):
+                line[i]
+            with self.assertRaises(IndexError):
+                idx[i]
+
+    def test_image_view(self):
+        """ test_image_view """
+        import numpy as np
+        m = get_i2t()
+
+        gray = (np.arange(20 * 30, dtype=np.uint8) % 251).reshape(20, 30)
+        img = m._impl.image(gray)
+        view = img.view(m.create_bbox(5, 2, 25, 12))
+        del img
+        # parent is kept alive by the view
+        self.assertTrue((view.materialize().to_array() == gray[2:12, 5:25]).all())
+        self.assertEqual(view.parent().bbox().width(), 30)
+        with self.assertRaises(ValueError):
+            view.parent().view(m.create_bbox(0, 0, 31, 10))
+
+        # the view keeps the raster it was created on
+        img = m._impl.image(gray)
+        view = img.view(m.create_bbox(15, 10, 29, 19))
+        img.downscale2x()
+        self.assertEqual(img.bbox().width(), 15)
+        self.assertTrue((view.materialize().to_array() == gray[10:19, 15:29]).all())
+
+    @unittest.skipUnless(hasattr(os, 'fork'), 'needs os.fork')
+    def test_fork_after_prefork(self):
+        """ test_fork_after_prefork - pool, executor and cache work in a forked child """
+        import asyncio
+        import gc
+        m = get_i2t()
+        impl = m._impl
+        f = os.path.join(test_data_dir, 'oneline/line1.png')
+        self.assertTrue(os.path.exists(f))
+
+        pool = impl.ocr_engine_pool('tesseract3', 'tesseract4', 1)
+        pool.init_all(os.path.join(m._dirs.configs, 'maz.v5.json'), m._dirs.lang, 'maz', 'maz-lstm')
+        ex = impl.executor(1, 4)
+        cache = impl.ocr_cache_stats()
+        impl.ocr_cache_configure(64)
+        try:
+            img = m.create_image(f)
+            expected, _ = impl.ocr_line(pool, img, False)
+            m.prefork()
+
+            pid = os.fork()
+            if 0 == pid:
+                ok = False
+                try:
+                    async def submit():
+                        return await impl.ocr_line_submit(ex, pool, img)
+                    s_async, _ = asyncio.run(submit())
+                    hits = impl.ocr_cache_stats()['hits']
+                    s_pool, _ = impl.ocr_line(pool, img, False)
+                    ok = (expected == s_async == s_pool and 1 == pool.available() and
+                          hits < impl.ocr_cache_stats()['hits'])
+                finally:
+                    os._exit(0 if ok else 1)
+
+            _, status = os.waitpid(pid, 0)
+            self.assertTrue(os.WIFEXITED(status))
+            self.assertEqual(0, os.WEXITSTATUS(status))
+        finally:
+            ex.shutdown()
+            impl.ocr_cache_configure(cache['max_entries'], cache['max_bytes'])
+            if hasattr(gc, 'unfreeze'):
+                gc.unfreeze()
+
+    @unittest.skipUnless(hasattr(os, 'fork'), 'needs os.fork')
+    def test_fork_with_readers(self):
+        """ test_fork_with_readers - image reader (prefetching) and lazy document work in a forked child """
+        import tempfile
+        import cv2
+        import numpy as np
+        m = get_i2t()
+
+        pages = [np.full((8, 8 + i), 50 * i, dtype=np.uint8) for i in range(3)]
+        js_str = testhelpers.synthetic_doc_json(m, rows=2, cols=2)[0]
+        lazy = m.load_doc_lazy(js_str)
+        expected = lazy.page(0).str()
+        with tempfile.TemporaryDirectory() as tmp:
+            f = os.path.join(tmp, 'pages.tif')
+            self.assertTrue(cv2.imwritemulti(f, pages))
+            reader = m.image_pages(f)
+            it = iter(reader)
+            next(it)  # page 2 is being prefetched
+
+            pid = os.fork()
+            if 0 == pid:
+                ok = False
+                try:
+                    ok = ((next(it).to_array() == pages[1]).all() and
+                          (reader[-1].to_array() == pages[2]).all() and
+                          expected == lazy.page(0).str())
+                finally:
+                    os._exit(0 if ok else 1)
+
+            _, status = os.waitpid(pid, 0)
+            self.assertTrue(os.WIFEXITED(status))
+            self.assertEqual(0, os.WEXITSTATUS(status))
+            self.assertTrue((next(it).to_array() == pages[1]).all())
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -1,10 +1,22 @@
 # coding=utf-8
 import os
 import unittest
-from testhelpers import get_i2t
+from testhelpers import get_i2t, synthetic_doc_json, ruled_table
 _this_dir = os.path.dirname(os.path.abspath(__file__))
 
 
+def doc_json(m):
+    """
+        Document json from `PYI2T_DOC_JSON` or generated from a synthetic table.
+        :return: (js_str, table_img) - the table stands in for the page image of a given json
+    """
+    f = os.environ.get('PYI2T_DOC_JSON', None)
+    if f is None:
+        return synthetic_doc_json(m)
+    with open(f, mode='r', encoding='utf-8') as fin:
+        return fin.read(), ruled_table()[0]
+
+
 class Test_perf(unittest.TestCase):
 
     @unittest.skip("update dirs")
@@ -38,6 +50,158 @@ class Test_perf(unittest.TestCase):
                 continue
             self.assertTrue(s == s_1)
 
+    def test_doc_serialization(self):
+        """ test_doc_serialization - json vs binary document hand-off """
+        import time
+        m = get_i2t()
+        doc = m.load_doc(doc_json(m)[0])
+        expected = doc.to_json_str()
+
+        def took(func, n=5):
+            s = time.perf_counter()
+            for _ in range(n):
+                res = func()
+            return (time.perf_counter() - s) / n, res
+
+        t_dump, _ = took(doc.to_json_str)
+        t_load, _ = took(lambda: m.load_doc(expected))
+        print('%-8s size:[%9d] dump:[%8.4fs] load:[%8.4fs]' %
+              ('json', len(expected.encode('utf-8')), t_dump, t_load))
+        for fmt in ('cbor', 'msgpack'):
+            t_dump, buf = took(lambda: doc.to_bytes(fmt))
+            t_load, doc2 = took(lambda: m.load_doc_bytes(memoryview(buf), fmt))
+            print('%-8s size:[%9d] dump:[%8.4fs] load:[%8.4fs]' %
+                  (fmt, len(buf), t_dump, t_load))
+            self.assertEqual(expected, doc2.to_json_str())
+
+    def test_lazy_document(self):
+        """ test_lazy_document - indexed pages equal the eagerly parsed ones """
+        import json
+        import tempfile
+        m = get_i2t()
+        js = json.loads(synthetic_doc_json(m)[0])
+
+        # the structural scan has to skip brackets, braces and quotes inside strings
+        page0 = js['pages'][0]
+        tricky = json.loads(json.dumps(page0))
+        tricky['lines'][0]['words'][0]['text'] = 'a]b}c"d\\e[f{g, h'
+        page_jss = [page0, tricky, page0]
+        js['pages'] = page_jss
+        header = {k: v for k, v in js.items() if 'pages' != k}
+
+        def single_page(p):
+            return m.load_doc(json.dumps(dict(header, pages=[p]))).to_json_str()
+
+        for js_str in (json.dumps(js), json.dumps(js, indent=2), json.dumps(js, separators=(',', ':'))):
+            doc = m.load_doc(js_str)
+            lazy = m.load_doc_lazy(js_str)
+            self.assertEqual(doc.page_len(), lazy.page_len())
+            self.assertEqual(len(page_jss), lazy.page_len())
+            for i, p in enumerate(page_jss):
+                self.assertEqual(single_page(p), lazy.page_document(i).to_json_str())
+            self.assertEqual(doc.last_page().str(), lazy.last_page().str())
+            self.assertEqual(lazy.page(2).str(), lazy.page(0).str())
+            self.assertEqual(tricky['lines'][0]['words'][0]['text'], lazy.page(1).lines()[0][0].text)
+
+        with tempfile.TemporaryDirectory() as tmp:
+            f = os.path.join(tmp, 'doc.json')
+            with open(f, mode='w', encoding='utf-8') as fout:
+                json.dump(js, fout, indent=1)
+            lazy = m.load_doc_lazy(file_str=f)
+            self.assertEqual(len(page_jss), lazy.page_len())
+            self.assertEqual(single_page(tricky), lazy.page_document(1).to_json_str())
+            # a loaded document keeps its pages
+            with self.assertRaises(RuntimeError):
+                lazy.from_str(json.dumps(js))
+
+        lazy = m.load_doc_lazy(json.dumps(header))
+        self.assertEqual(0, lazy.page_len())
+        with self.assertRaises(IndexError):
+            lazy.last_page()
+        with self.assertRaises(IndexError):
+            lazy.page(0)
+        for broken in ('', '[]', '{"pages": [{"lines": []}', '{"pages": ["a]}'):
+            with self.assertRaises(ValueError):
+                m.load_doc_lazy(broken)
+
+    def test_ia_lines_many(self):
+        """ test_ia_lines_many - parallel batch equals the serial calls """
+        import time
+        m = get_i2t()
+        table, _ = ruled_table()
+        imgs = [m._impl.image(table) for _ in range(8)]
+
+        s = time.perf_counter()
+        expected = [m.ia_lines(img, 30) for img in imgs]
+        t_serial = time.perf_counter() - s
+        s = time.perf_counter()
+        res = m.ia_lines_many(imgs, 30)
+        t_many = time.perf_counter() - s
+        print('ia_lines serial:[%8.4fs] many:[%8.4fs]' % (t_serial, t_many))
+
+        key = lambda lines: [str(b) for b in lines]
+        self.assertTrue(0 < len(expected[0][0]))
+        for (h1, v1), (h2, v2) in zip(expected, res):
+            self.assertEqual(key(h1), key(h2))
+            self.assertEqual(key(v1), key(v2))
+
+    def test_ia_lines_roi(self):
+        """ test_ia_lines_roi - roi is clamped to the image """
+        m = get_i2t()
+        table, _ = ruled_table()
+        img = m._impl.image(table)
+        h, w = table.shape
+
+        key = lambda lines: [str(b) for b in lines]
+        h1, v1 = m.ia_lines(img, 30)
+        h2, v2 = m.ia_lines(img, 30, roi=m.create_bbox(-50, -50, w + 50, h + 50))
+        self.assertEqual(key(h1), key(h2))
+        self.assertEqual(key(v1), key(v2))
+
+        h3, v3 = m.ia_lines(img, 30, roi=m.create_bbox(w + 10, h + 10, w + 100, h + 100))
+        self.assertEqual(0, len(h3) + len(v3))
+
+    def test_process_ib_equivalence(self):
+        """ test_process_ib_equivalence - native pipeline equals the python stage flow """
+        m = get_i2t()
+        impl = m._impl
+        js_str, table = doc_json(m)
+
+        def binarized():
+            imgb = impl.image(table)
+            imgb.binarize_otsu()
+            return imgb
+
+        # python flow
+        doc = m.load_doc(js_str)
+        p = doc.last_page()
+        imgb = binarized()
+        grid = m.create_grid_info(p)
+        cols = m.detect_columns(p, imgb, grid) or impl.create_columns(p)
+        r = m.create_report(doc, cols, grid, imgb)
+        ib_cols = None
+        if r.is_allowed(r.k_find_columns):
+            ib_cols = r.find_columns()
+        if r.is_allowed(r.k_handle_corner_case):
+            ib_cols = r.handle_corner_case(ib_cols)
+        if r.is_allowed(r.k_words_to_columns):
+            ib_cols = r.words_to_columns(ib_cols)
+        if r.is_allowed(r.k_best_columns):
+            ib_cols = r.best_columns(ib_cols)
+        if r.is_allowed(r.k_parse):
+            ib_cols = r.parse(ib_cols)
+        if ib_cols is not None:
+            r.save_ib_info(ib_cols)
+
+        # native pipeline on a document loaded from the same json
+        doc2 = m.load_doc(js_str)
+        p2 = doc2.last_page()
+        res = m.process_ib(doc2, binarized(), m.create_grid_info(p2))
+        print('process_ib timing: %s' % res['timing'])
+
+        self.assertEqual(repr(ib_cols), repr(res['columns']))
+        self.assertEqual(r.size(), res['report'].size())
+
 
 if __name__ == '__main__':
     unittest.main()
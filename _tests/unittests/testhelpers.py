@@ -52,3 +52,74 @@ def get_dirs():
 
     from i2t import dir_spec
     return dir_spec(bin_dir=bin_dir, config_dir=config_dir, lang_dir=lang_dir)
+
+
+# =================
+# generated inputs
+
+_WORDS = ("Room", "Board", "Pharmacy", "Laboratory", "Radiology", "Supplies",
+          "0250", "0300", "12/01/2019", "$1,234.56", "Total", "Charges", "Units")
+
+
+def ruled_table(seed=3, rows=12, cols=4, cell_w=260, cell_h=48):
+    """
+        Ruled itemized-bill like gray table, one word per cell.
+        :return: (img, row_bboxes) - row bboxes are the strips between the rules
+    """
+    import cv2
+    import numpy as np
+    rng = np.random.RandomState(seed)
+    h, w = rows * cell_h + 40, cols * cell_w + 40
+    img = np.full((h, w), 255, dtype=np.uint8)
+    for r in range(rows + 1):
+        y = 20 + r * cell_h
+        img[y:y + 2, 20:w - 20] = 0
+    for c in range(cols + 1):
+        x = 20 + c * cell_w
+        img[20:h - 20, x:x + 2] = 0
+    row_bboxes = []
+    for r in range(rows):
+        y = 20 + r * cell_h
+        for c in range(cols):
+            word = _WORDS[rng.randint(0, len(_WORDS))]
+            cv2.putText(img, word, (30 + c * cell_w, y + 34), cv2.FONT_HERSHEY_SIMPLEX,
+                        0.8, 0, 2, cv2.LINE_AA)
+        row_bboxes.append((22, y + 2, w - 20, y + cell_h))
+    return img, row_bboxes
+
+
+def _bbox_like(sample, xlt, ylt, xrb, yrb):
+    """ bbox in the json representation of `sample` (a word bbox). """
+    coords = [xlt, ylt, xrb, yrb]
+    if isinstance(sample, dict):
+        return dict(zip(sample.keys(), coords))
+    return coords
+
+
+def synthetic_doc_json(m, seed=3, rows=12, cols=4):
+    """
+        Minimal document json of `ruled_table` - every row OCRed with the v3
+        engine, word bboxes moved to page coordinates.
+        :return: (js_str, table_img)
+    """
+    import json
+    img, row_bboxes = ruled_table(seed, rows, cols)
+    lines = []
+    for x0, y0, x1, y1 in row_bboxes:
+        _, words = m.ocr_line_v3(img[y0:y1, x0:x1].copy())
+        js_words = []
+        for w in words:
+            b = w.bbox
+            w.bbox = m.create_bbox(b.xlt() + x0, b.ylt() + y0, b.xrb() + x0, b.yrb() + y0)
+            js_words.append(w.to_py())
+        if js_words:
+            lines.append({"bbox": (x0, y0, x1, y1), "words": js_words})
+    if not lines:
+        raise RuntimeError('no words recognised in the synthetic table')
+
+    sample = lines[0]["words"][0]["bbox"]
+    for line in lines:
+        line["bbox"] = _bbox_like(sample, *line["bbox"])
+    h, w = img.shape
+    page = {"bbox": _bbox_like(sample, 0, 0, w - 1, h - 1), "lines": lines}
+    return json.dumps({"pages": [page]}), img
@@ -2,7 +2,6 @@
 """
   py wrapper for i2t
 """
-import json
 import os
 import logging
 import importlib
@@ -128,9 +127,12 @@ class _img(object):
         """
         self._img = None
         self._file_str = None
+        # False if the caller owns the image (must not be modified)
+        self.owned = True
 
-        if isinstance(img, m._impl.image):
+        if isinstance(img, (m._impl.image, m._impl.image_view)):
             self._img = img
+            self.owned = False
             return
 
         if isinstance(img, str):
@@ -142,6 +144,17 @@ class _img(object):
             self._img = m.create_image_from_png(img['base64'])
             return
 
+        if isinstance(img, (bytes, bytearray, memoryview)):
+            self._img = m.create_image_from_bytes(img)
+            return
+
+        # uint8 gray/colour arrays are converted in memory
+        try:
+            self._img = m._impl.image(img)
+            return
+        except (TypeError, ValueError):
+            pass
+
         # faster than `np_to_png_base64`
         self._file_str = np_2_file(img)
         self._img = m._impl.image(self._file_str)
@@ -180,14 +193,22 @@ class _i2t(object):
         self._path = None
         self._deps = []
         self._dirs = None
+        self.pool = None
+        self._target_letter_h = 0
+        self._executor = None
+        self._ib_form_model = None
+        self._ub04_classifier = None
+        self.startup_timing = {}
+        self.oem = None
+        self.t3 = None
+        self.t4 = None
         if os.path.exists(os.path.join(_this_dir, 'bins')):
             dirs = dir_spec(_this_dir)
             self.init(dirs)
-        self.t3 = None
-        self.t4 = None
 
     def init(self, dirs):
         _logger.debug('OCR models loading')
+        start = time.perf_counter()
         self._dirs = dirs
         real_module_dir_str = os.path.abspath(dirs.bins)
         if real_module_dir_str not in sys.path:
@@ -210,29 +231,70 @@ class _i2t(object):
                 self._deps.append(loaded_lib)
             self._impl = importlib.import_module('pyi2t3')
         self._path = self._impl.__file__
+        self.startup_timing = {'load_module': time.perf_counter() - start}
+        self._register_fork_hooks()
         if os.environ.get('MAZ_EXT_OCR_MODELS', '1') == '0':
             _logger.debug('OCR models (lazy) loaded')
             return
 
+        # both engines are initialized straight from the config
         oem = self._impl.ocr_engine_manager('tesseract3', 'tesseract4')
         conf = os.path.join(dirs.configs, 'maz.v5.json')
-        with open(conf, mode='r') as fin:
-            js = json.load(fin)
-        ocr_js = js['ocr-params']
-
-        env3 = self._impl.env()
-        for k, v in ocr_js['default'].items():
-            env3[k] = str(v)
-
-        env4 = self._impl.env()
-        for k, v in ocr_js['reocr'].items():
-            env4[k] = str(v)
+        self.startup_timing['engines'] = oem.init_all(conf, dirs.lang, 'maz', 'maz-lstm')
 
+        self.oem = oem
         self.t3 = oem.ocr()
-        self.t3.init(dirs.lang, 'maz', env3)
         self.t4 = oem.reocr()
-        self.t4.init(dirs.lang, 'maz-lstm', env4)
-        _logger.info('OCR models loaded')
+
+        # independent engine pairs so that python threads can OCR in parallel
+        pool_size = int(os.environ.get('MAZ_OCR_POOL_SIZE', '0'))
+        if 0 < pool_size:
+            self.pool = self._impl.ocr_engine_pool(
+                'tesseract3', 'tesseract4', pool_size)
+            self.startup_timing['pool'] = self.pool.init_all(conf, dirs.lang, 'maz', 'maz-lstm')
+
+        # opt-in: OCR high resolution text on a halved copy (bboxes are mapped back)
+        self._target_letter_h = int(os.environ.get('MAZ_OCR_TARGET_LETTER_H', '0'))
+
+        # repeated crops (retries, v3 followed by v4) skip tesseract
+        cache_entries = int(os.environ.get('MAZ_OCR_CACHE_ENTRIES', '0'))
+        if 0 < cache_entries:
+            cache_mb = int(os.environ.get('MAZ_OCR_CACHE_MB', '0'))
+            self._impl.ocr_cache_configure(cache_entries, cache_mb * 1024 * 1024)
+        self.startup_timing['total'] = time.perf_counter() - start
+        _logger.info('OCR models loaded %s', self.startup_timing)
+
+    _fork_hooks = False
+
+    def _register_fork_hooks(self):
+        """
+            Native locks are taken around fork() and native worker threads
+            (executor) are restarted lazily in the child.
+        """
+        if type(self)._fork_hooks or not hasattr(os, 'register_at_fork'):
+            return
+        os.register_at_fork(before=self._impl.fork_before,
+                            after_in_parent=self._impl.fork_after_parent,
+                            after_in_child=self._impl.fork_after_child)
+        type(self)._fork_hooks = True
+
+    def prefork(self, dirs=None):
+        """
+            Load models, templates and classifiers in the parent before worker
+            processes fork (e.g. gunicorn `preload_app`) and freeze the python
+            heap so that the collector does not write to - and thus copy - the
+            shared pages in every worker.
+            Do not fork while OCR is running in other threads.
+        """
+        import gc
+        if dirs is not None:
+            self.init(dirs)
+        if self._dirs is not None and os.path.isdir(self._dirs.configs):
+            self._ib_model()
+            self._ub04_cls()
+        gc.collect()
+        if hasattr(gc, 'freeze'):
+            gc.freeze()
 
     def bin_path(self) -> str:
         """
@@ -245,6 +307,15 @@ class _i2t(object):
     def version(self):
         return self._impl.__version__
 
+    def metrics(self, reset=False):
+        """
+            Native timing of the bound entry points (excludes waiting for the GIL).
+        """
+        d = self._impl.metrics()
+        if reset:
+            self._impl.metrics_reset()
+        return d
+
     # =============
 
     @perf_method()
@@ -263,6 +334,53 @@ class _i2t(object):
     def reocr_v4(self, i2t_page_img, i2t_bbox, raw=False):
         return self._reocr(i2t_page_img, i2t_bbox, self.t4, raw)
 
+    def reocr_many_v4(self, i2t_page_img, i2t_bboxes, raw=False):
+        """
+            :return: list of (s, words_arr) - one per bbox, in order
+        """
+        with perf_probe('reocr_many'):
+            target, _ = self._pooled(self.t4)
+            return self._impl.reocr_many(target, i2t_page_img, list(i2t_bboxes), raw)
+
+    def ocr_line_cascade(self, file_str_or_np_img_or_pyimg, min_conf, check_dict=True,
+                         v3_scale=100., v4_scale=100.):
+        """
+            v3 OCR, only words below `min_conf` (confidence in [0, 1]) or unknown
+            to the dictionary are reOCRed with v4; `v3_scale`/`v4_scale` is the
+            full confidence each engine reports. See `ocr_cascade_stats()` for
+            the saved work.
+        """
+        args = self.image_wrapper(file_str_or_np_img_or_pyimg)
+        img = self._pixels(args.img)
+        target = self.pool if self.pool is not None else self.oem
+        with perf_probe('ocr_cascade'):
+            return self._impl.ocr_cascade(target, img, min_conf, check_dict, v3_scale, v4_scale)
+
+    # asyncio variants, need `MAZ_OCR_POOL_SIZE`
+
+    def executor(self):
+        """
+            Native worker pool completing asyncio futures, one worker per pooled
+            engine pair; `MAZ_EXECUTOR_QUEUE` bounds the queue (QueueFull when full).
+        """
+        if self._executor is None:
+            if self.pool is None:
+                raise RuntimeError('async OCR needs MAZ_OCR_POOL_SIZE')
+            max_queue = int(os.environ.get('MAZ_EXECUTOR_QUEUE', '64'))
+            self._executor = self._impl.executor(len(self.pool), max_queue)
+        return self._executor
+
+    async def ocr_line_v3_async(self, file_str_or_np_img_or_pyimg):
+        args = self.image_wrapper(file_str_or_np_img_or_pyimg)
+        return await self._impl.ocr_line_submit(self.executor(), self.pool, args.img, False)
+
+    async def ocr_line_v4_async(self, file_str_or_np_img_or_pyimg):
+        args = self.image_wrapper(file_str_or_np_img_or_pyimg)
+        return await self._impl.ocr_line_submit(self.executor(), self.pool, args.img, True)
+
+    async def reocr_v4_async(self, i2t_page_img, i2t_bbox, raw=False):
+        return await self._impl.reocr_submit(self.executor(), self.pool, i2t_page_img, i2t_bbox, raw)
+
     def ocr_block_v3(self, file_str_or_np_img_or_pyimg, binarize=None):
         args = self.image_wrapper(file_str_or_np_img_or_pyimg)
         return self._ocr_block(args.img, self.t3, binarize=binarize)
@@ -293,27 +411,35 @@ class _i2t(object):
                 * features - dict
                 * ib_section - bbox
         """
-        ibf = self._impl.ml_ib_form(self._dirs.configs)
-        ibf.process(page)
-        doc_tp = ibf.type()
-        is_ib = doc_tp.is_ib()
-        ib_bbox = ibf.get_ib_section() if is_ib else None
-        features = ibf.json_features_s()
-        try:
-            features = json.loads(features)
-        except Exception:
-            pass
-        type_s = doc_tp.str()  # no, report, invalid
+        return self._ib_form_result(self._ib_model().process(page))
+
+    def is_ib_form_many(self, pages, threads=0):
+        """
+            `is_ib_form` for all pages (e.g. of a document) in one native call,
+            pages run in parallel on `threads` workers (0 - `set_threads` default).
+        """
+        return [self._ib_form_result(r)
+                for r in self._ib_model().process_many(list(pages), threads)]
+
+    def _ib_model(self):
+        """ Classifier configuration is loaded once and shared. """
+        if self._ib_form_model is None:
+            self._ib_form_model = self._impl.ml_ib_form_model(self._dirs.configs)
+        return self._ib_form_model
+
+    @staticmethod
+    def _ib_form_result(res):
+        type_s = res["type"]  # no, report, invalid
         if type_s == "report":
             type_s = "IB"
 
         d = {
             "valid": True,
             "type": type_s,
-            "ib_section": ib_bbox,
-            "features": features,
+            "ib_section": res["ib_section"],
+            "features": res["features"],
         }
-        return is_ib, d
+        return res["is_ib"], d
 
     def ml_ib_form_prepare(self, doc):
         self._impl.ml_ib_form_prepare(doc)
@@ -325,8 +451,9 @@ class _i2t(object):
         # TODO: do we really want to process_img, if it after post-ocr?
         process_img = True
         pyi2t_img = self.image_wrapper(img_path_or_d)
-        ub_templ = os.path.join(self._dirs.configs, "ub04-bbox-template.json")
-        ubf = self._impl.ub04_form.classify(pyi2t_img.img, ub_templ, process_img)
+        # images we created may be preprocessed in place, views always copy their region
+        kw = {'in_place': True} if pyi2t_img.owned else {}
+        ubf = self._ub04_cls().classify(pyi2t_img.img, process_img, **kw)
         d = {
             "valid": ubf.valid(),
             "type": "no",
@@ -366,6 +493,13 @@ class _i2t(object):
 
         return use_this, d
 
+    def _ub04_cls(self):
+        """ Classifier (and its preprocessing env) is created once. """
+        if self._ub04_classifier is None:
+            ub_templ = os.path.join(self._dirs.configs, "ub04-bbox-template.json")
+            self._ub04_classifier = self._impl.ub04_classifier(ub_templ)
+        return self._ub04_classifier
+
     def ub_parser(self, i2t_doc, i2t_ib_bbox):
         return self._impl.ub_parser(i2t_doc, i2t_ib_bbox)
 
@@ -380,6 +514,29 @@ class _i2t(object):
         doc.from_str(js_str)
         return doc
 
+    def load_doc_lazy(self, js_str=None, file_str=None):
+        """
+            Index document json pages without parsing them, `page(i)`/`last_page()`
+            parse only the requested page and `page_document(i)` gives a single page
+            document for calls which require one.
+        """
+        env = self._impl.env()
+        doc = self._impl.lazy_document(env)
+        if file_str is not None:
+            doc.from_file(file_str)
+        else:
+            doc.from_str(js_str)
+        return doc
+
+    def load_doc_bytes(self, buf, fmt='cbor'):
+        """
+            Load document representation from `document.to_bytes` output.
+        """
+        env = self._impl.env()
+        doc = self._impl.document(env)
+        doc.from_bytes(buf, fmt)
+        return doc
+
     # =============
 
     def create_grid_info(self, page, hlines=None, vlines=None):
@@ -396,26 +553,80 @@ class _i2t(object):
         """
         return self._impl.la_gridrows(gridcells)
 
-    def create_report(self, doc, cols, grid, imgb, dbg=''):
+    def load_ib_form_template(self, doc):
         """
-            Create IB report object
+            Parse the IB form template for `doc` - pass it as `template` to the
+            calls on the same document instead of parsing it in each of them.
         """
         tmpl_path = os.path.join(self._dirs.configs, 'ib-template.json')
-        return self._impl.create_report(doc, cols, grid, tmpl_path, imgb, dbg=dbg)
+        return self._impl.load_ib_form_template(tmpl_path, doc)
+
+    def create_report(self, doc, cols, grid, imgb, dbg='', template=None):
+        """
+            Create IB report object, `template` from `load_ib_form_template(doc)`
+        """
+        if template is None:
+            template = self.load_ib_form_template(doc)
+        return self._impl.create_report(doc, cols, grid, template, imgb, dbg=dbg)
+
+    def process_ib(self, doc, imgb, grid, cols=None, dbg='', ib_bbox=None, template=None):
+        """
+            Whole IB extraction (report + template gated stages) in one native call.
+            Without `cols` the table layout columns inside `ib_bbox` are tried
+            first, then `detect_columns`.
+            Returns dict with `report`, `columns` (None if parsing failed) and
+            per stage `timing` in seconds.
+        """
+        if template is None:
+            template = self.load_ib_form_template(doc)
+        return self._impl.process_ib(doc, imgb, grid, template, cols, dbg=dbg, ib_bbox=ib_bbox)
 
     def create_image_from_png(self, image_date_base64_png, mimetype: str = 'image/png'):
         return self._impl.image(image_date_base64_png, mimetype)
 
+    def create_image_from_bytes(self, buf, mimetype: str = ''):
+        """
+            Decode raw (not base64) png/tiff/jpeg bytes, `mimetype` is checked when given.
+        """
+        return self._impl.image.from_bytes(buf, mimetype)
+
     def create_image(self, file_str):
         return self._impl.image(file_str)
 
+    def image_pages(self, file_str, prefetch=True):
+        """
+            Lazy page reader - `len()` gives the page count, iterate or index (0-based, negative from the end)
+            to decode pages one at a time.
+        """
+        return self._impl.image_reader(file_str, prefetch)
+
+    def image_ops_many(self, imgs, ops, threads=0):
+        """
+            Apply in-place `ops` (e.g. ['to8bpp', 'binarize_sauvola']) to all
+            images in parallel.
+        """
+        self._impl.image_ops_many(imgs, ops, threads)
+        return imgs
+
+    def image_view(self, img, i2t_bbox):
+        """
+            Region of `img` without copying pixels - accepted instead of an image
+            by OCR, `reocr_v4` (as page image + bbox), `ia_lines` and UB04 classification.
+            The view keeps the pixels `img` had when it was created, later
+            operations on `img` (e.g. `downscale2x`) do not change it.
+        """
+        return img.view(i2t_bbox)
+
     def create_bbox(self, xlt, ylt, xrb, yrb):
         return self._impl.bbox_type(xlt, ylt, xrb, yrb)
 
     # =============
 
-    def ia_lines(self, imgb, letter_h, dbg=''):
-        return self._impl.ia_lines(imgb, letter_h, dbg)
+    def ia_lines(self, imgb, letter_h, dbg='', roi=None):
+        return self._impl.ia_lines(imgb, letter_h, dbg, roi)
+
+    def ia_lines_many(self, imgbs, letter_h, threads=0):
+        return self._impl.ia_lines_many(imgbs, letter_h, threads)
 
     # =============
 
@@ -458,38 +669,61 @@ class _i2t(object):
         return seg.segments()
 
     def subtypes_dict(self, subtypes_arr):
-        s = self._impl.json_subtypes_s(subtypes_arr)
-        return json.loads(s)
+        return self._impl.subtypes_py(subtypes_arr)
 
     # =============
 
+    def _pooled(self, engine):
+        """
+            Return `(engine_or_pool, kwargs)` - with `MAZ_OCR_POOL_SIZE` set
+            the calls go through the engine pool instead of the shared engine.
+        """
+        kw = {'target_letter_h': self._target_letter_h} if 0 < self._target_letter_h else {}
+        if self.pool is None:
+            return engine, kw
+        kw['reocr'] = engine is self.t4
+        return self.pool, kw
+
+    def _pixels(self, img):
+        """ Views are materialized (region copy) for in-place operations. """
+        if isinstance(img, self._impl.image_view):
+            return img.materialize()
+        return img
+
     def _ocr_line(self, img, engine, binarize):
         with perf_probe('binarize'):
             if binarize == 'otsu':
+                img = self._pixels(img)
                 img.binarize_otsu()
         with perf_probe('ocr_line'):
-            s, words_arr = self._impl.ocr_line(engine, img, False)
+            target, kw = self._pooled(engine)
+            s, words_arr = self._impl.ocr_line(target, img, False, **kw)
         return s, words_arr
 
     def _reocr(self, i2t_page_img, i2t_bbox, engine, raw=False):
         with perf_probe('reocr'):
-            s, words_arr = self._impl.reocr(engine, i2t_page_img, i2t_bbox, raw)
+            target, _ = self._pooled(engine)
+            s, words_arr = self._impl.reocr(target, i2t_page_img, i2t_bbox, raw)
         return s, words_arr
 
     def _ocr_block(self, img, engine, binarize):
         with perf_probe('binarize'):
             if binarize == 'otsu':
+                img = self._pixels(img)
                 img.binarize_otsu()
         with perf_probe('ocr_line'):
-            s, words_arr = self._impl.ocr_block(engine, img)
+            target, kw = self._pooled(engine)
+            s, words_arr = self._impl.ocr_block(target, img, **kw)
         return s, words_arr
 
     def _ocr_word(self, img, engine, binarize):
         with perf_probe('binarize'):
             if binarize == 'otsu':
+                img = self._pixels(img)
                 img.binarize_otsu()
         with perf_probe('ocr_line'):
-            s, words_arr = self._impl.ocr_word(engine, img)
+            target, kw = self._pooled(engine)
+            s, words_arr = self._impl.ocr_word(target, img, **kw)
         return s, words_arr
 
 
@@ -8,6 +8,10 @@
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
 
+#include <iterator>
+#include <utility>
+#include <vector>
+
 // make env accessible via reference
 PYBIND11_MAKE_OPAQUE(std::map<std::string, std::string>);
 using maz_env_type = std::map<std::string, std::string>;
@@ -26,4 +30,55 @@ namespace maz {
     /** Export processing extensions - IB forms. */
     void init_forms(pybind11::module&);
 
+    namespace pylib {
+
+        /** Python style (negative allowed) index into `n` items, raises IndexError. */
+        inline size_t py_index(pybind11::ssize_t i, size_t n)
+        {
+            const pybind11::ssize_t sn = static_cast<pybind11::ssize_t>(n);
+            if (i < 0) i += sn;
+            if (i < 0 || i >= sn) throw pybind11::index_error();
+            return static_cast<size_t>(i);
+        }
+
+        /**
+         * Python style (negative allowed) indexing into a bidirectional container,
+         * walks from the nearer end.
+         */
+        template <typename container_type>
+        auto py_at(const container_type& c, pybind11::ssize_t i) -> decltype(c.begin())
+        {
+            const pybind11::ssize_t n = static_cast<pybind11::ssize_t>(c.size());
+            i = static_cast<pybind11::ssize_t>(py_index(i, c.size()));
+            if (i <= n / 2) return std::next(c.begin(), i);
+            return std::prev(c.end(), n - i);
+        }
+
+        /**
+         * O(1) python style indexing into a bidirectional container - the
+         * iterators are collected by one walk. Valid while the container is
+         * not modified.
+         */
+        template <typename container_type>
+        class indexed
+        {
+        public:
+            using iterator = decltype(std::declval<const container_type&>().begin());
+
+            explicit indexed(const container_type& c)
+            {
+                its_.reserve(c.size());
+                for (iterator it = c.begin(); it != c.end(); ++it) its_.push_back(it);
+            }
+
+            size_t size() const { return its_.size(); }
+
+            iterator at(pybind11::ssize_t i) const { return its_[py_index(i, its_.size())]; }
+
+        private:
+            std::vector<iterator> its_;
+        };
+
+    } // namespace pylib
+
 } // namespace maz
@@ -0,0 +1,288 @@
+#pragma once
+
+#include "pylib_fork.h"
+
+#include <pybind11/pybind11.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace maz {
+namespace pylib {
+
+    /** `executor::submit` on a full queue - maps to python `QueueFull`. */
+    class queue_full : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * Native worker pool with a bounded queue whose jobs complete asyncio
+     * futures. A job runs without the GIL, only the conversion of its result
+     * and the hand-off to the event loop (`call_soon_threadsafe`) take it.
+     * Cancelling the future before a worker picks the job up skips the work.
+     */
+    class executor
+    {
+    public:
+        /** Converts a finished native result, called with the GIL held. */
+        using result_fn = std::function<pybind11::object()>;
+        /** Native part of a job, called without the GIL. */
+        using work_fn = std::function<result_fn()>;
+
+        executor(size_t threads, size_t max_queue) : max_queue_(max_queue)
+        {
+            if (0 == max_queue_) throw std::invalid_argument("executor queue size must be positive");
+            threads_ = std::max<size_t>(1, 0 < threads ? threads : std::thread::hardware_concurrency());
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                start_locked();
+            }
+            fork_id_ = fork_hooks().add(
+                [this]() { mtx_.lock(); },
+                [this]() { mtx_.unlock(); },
+                [this]() { after_fork_child(); });
+        }
+
+        executor(const executor&) = delete;
+        executor& operator=(const executor&) = delete;
+
+        ~executor()
+        {
+            fork_hooks().remove(fork_id_);
+            shutdown();
+        }
+
+        /**
+         * Queue `work` and return an `asyncio.Future` of the running loop.
+         * `keep_alive` holds the python arguments `work` refers to.
+         */
+        pybind11::object submit(work_fn work, pybind11::object keep_alive)
+        {
+            namespace py = pybind11;
+            check_accepting();
+
+            py::object loop = py::module::import("asyncio").attr("get_running_loop")();
+            py::object fut = loop.attr("create_future")();
+            auto cancelled = std::make_shared<std::atomic<bool>>(false);
+            fut.attr("add_done_callback")(py::cpp_function([cancelled](py::object f) {
+                if (f.attr("cancelled")().cast<bool>()) *cancelled = true;
+            }));
+
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                check_accepting_locked();
+                // workers are not inherited by a forked child
+                if (workers_.empty()) start_locked();
+                queue_.push_back(job{std::move(work), loop, fut, std::move(keep_alive), cancelled});
+            }
+            cv_.notify_one();
+            return fut;
+        }
+
+        /** Convenience for native functions returning a python castable value. */
+        template <typename F>
+        pybind11::object submit_value(F fn, pybind11::object keep_alive)
+        {
+            return submit([fn]() -> result_fn {
+                auto pres = std::make_shared<decltype(fn())>(fn());
+                return [pres]() { return pybind11::cast(std::move(*pres)); };
+            }, std::move(keep_alive));
+        }
+
+        size_t pending() const
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return queue_.size();
+        }
+
+        size_t threads() const { return threads_; }
+        size_t max_queue() const { return max_queue_; }
+
+        /**
+         * Stop accepting jobs, cancel the queued ones and wait for the running
+         * ones. Must be called with the GIL held.
+         */
+        void shutdown()
+        {
+            namespace py = pybind11;
+            std::deque<job> dropped;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                stop_ = true;
+                dropped.swap(queue_);
+            }
+            cv_.notify_all();
+            {
+                // running jobs need the GIL to complete their futures
+                py::gil_scoped_release release;
+                for (auto& w : workers_) {
+                    if (w.joinable()) w.join();
+                }
+            }
+            workers_.clear();
+            for (auto& j : dropped) {
+                try {
+                    j.loop.attr("call_soon_threadsafe")(j.future.attr("cancel"));
+                } catch (py::error_already_set&) {
+                    // loop already closed
+                }
+            }
+        }
+
+    private:
+        struct job
+        {
+            work_fn work;
+            pybind11::object loop;
+            pybind11::object future;
+            pybind11::object keep_alive;
+            std::shared_ptr<std::atomic<bool>> cancelled;
+        };
+
+        void start_locked()
+        {
+            for (size_t i = 0; i < threads_; ++i) workers_.emplace_back([this]() { run(); });
+        }
+
+        /**
+         * Only the forking thread exists in the child - the worker handles and
+         * the queued jobs (futures of the parent's loops) are abandoned without
+         * touching them, workers are started again by the next `submit`.
+         */
+        void after_fork_child()
+        {
+            static_cast<void>(new std::vector<std::thread>(std::move(workers_)));
+            workers_.clear();
+            for (auto& j : queue_) {
+                j.loop.release();
+                j.future.release();
+                j.keep_alive.release();
+            }
+            queue_.clear();
+            new (&cv_) std::condition_variable();
+            mtx_.unlock();
+        }
+
+        void check_accepting()
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            check_accepting_locked();
+        }
+
+        void check_accepting_locked() const
+        {
+            if (stop_) throw std::runtime_error("executor is shut down");
+            if (queue_.size() >= max_queue_)
+                throw queue_full("executor queue is full (" + std::to_string(max_queue_) + " jobs)");
+        }
+
+        void run()
+        {
+            for (;;) {
+                job j;
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+                    if (queue_.empty()) return;
+                    j = std::move(queue_.front());
+                    queue_.pop_front();
+                }
+
+                result_fn to_py;
+                std::exception_ptr perr;
+                if (!*j.cancelled) {
+                    try {
+                        to_py = j.work();
+                    } catch (...) {
+                        perr = std::current_exception();
+                    }
+                }
+
+                pybind11::gil_scoped_acquire gil;
+                complete(j, to_py, perr);
+                // python references are released while the GIL is held
+                j = job();
+                to_py = nullptr;
+            }
+        }
+
+        static void complete(job& j, const result_fn& to_py, std::exception_ptr perr)
+        {
+            namespace py = pybind11;
+            if (*j.cancelled) return;
+            try {
+                bool ok = !perr;
+                py::object value;
+                if (ok) {
+                    try {
+                        value = to_py();
+                    } catch (...) {
+                        ok = false;
+                        perr = std::current_exception();
+                    }
+                }
+                if (!ok) value = to_exception(perr);
+                j.loop.attr("call_soon_threadsafe")(settle(), j.future, ok, value);
+            } catch (py::error_already_set&) {
+                // loop already closed, nobody waits for the result
+            }
+        }
+
+        /** `settle(fut, ok, value)` - sets the result unless the future is done (cancelled). */
+        static pybind11::object settle()
+        {
+            namespace py = pybind11;
+            // intentionally leaked, must outlive module teardown
+            static py::object* pfn = new py::object(py::cpp_function([](py::object fut, bool ok, py::object value) {
+                if (fut.attr("done")().cast<bool>()) return;
+                fut.attr(ok ? "set_result" : "set_exception")(value);
+            }));
+            return *pfn;
+        }
+
+        static pybind11::object to_exception(std::exception_ptr perr)
+        {
+            namespace py = pybind11;
+            auto make = [](PyObject* tp, const char* msg) {
+                return py::reinterpret_borrow<py::object>(tp)(msg);
+            };
+            try {
+                std::rethrow_exception(perr);
+            } catch (py::error_already_set& e) {
+                return e.value();
+            } catch (const std::invalid_argument& e) {
+                return make(PyExc_ValueError, e.what());
+            } catch (const std::out_of_range& e) {
+                return make(PyExc_IndexError, e.what());
+            } catch (const std::exception& e) {
+                return make(PyExc_RuntimeError, e.what());
+            } catch (...) {
+                return make(PyExc_RuntimeError, "unknown native error");
+            }
+        }
+
+        size_t max_queue_;
+        size_t threads_ = 0;
+        size_t fork_id_ = 0;
+        bool stop_ = false;
+        std::deque<job> queue_;
+        std::vector<std::thread> workers_;
+        mutable std::mutex mtx_;
+        std::condition_variable cv_;
+    };
+
+} // namespace pylib
+} // namespace maz
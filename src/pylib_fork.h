@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace maz {
+namespace pylib {
+
+    /**
+     * Hooks run around `fork()` (wired to `os.register_at_fork` by `i2t.py`).
+     *
+     * `before` takes the locks of the registered components so that no other
+     * thread holds them while the address space is copied, `after_parent`
+     * releases them and `after_child` releases them and resets state that
+     * refers to threads which do not exist in the child.
+     */
+    class fork_handlers
+    {
+    public:
+        using handler = std::function<void()>;
+
+        size_t add(handler before, handler after_parent, handler after_child)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mtx_);
+            entries_[++last_id_] = entry{std::move(before), std::move(after_parent), std::move(after_child)};
+            return last_id_;
+        }
+
+        /** Convenience for a component guarded by one mutex only. */
+        size_t add_mutex(std::mutex& mtx)
+        {
+            return add([&mtx]() { mtx.lock(); }, [&mtx]() { mtx.unlock(); }, [&mtx]() { mtx.unlock(); });
+        }
+
+        void remove(size_t id)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mtx_);
+            entries_.erase(id);
+        }
+
+        void before()
+        {
+            mtx_.lock();
+            for (auto& kv : entries_) kv.second.before();
+        }
+
+        void after_parent()
+        {
+            for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) it->second.after_parent();
+            mtx_.unlock();
+        }
+
+        void after_child()
+        {
+            for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) it->second.after_child();
+            mtx_.unlock();
+        }
+
+    private:
+        struct entry
+        {
+            handler before;
+            handler after_parent;
+            handler after_child;
+        };
+
+        // recursive - a hook may (un)register components
+        std::recursive_mutex mtx_;
+        std::map<size_t, entry> entries_;
+        size_t last_id_ = 0;
+    };
+
+    inline fork_handlers& fork_hooks()
+    {
+        // intentionally leaked, components unregister during static destruction
+        static fork_handlers* phooks = new fork_handlers();
+        return *phooks;
+    }
+
+} // namespace pylib
+} // namespace maz
@@ -18,6 +18,21 @@
 #include "ocr/processing.h"
 #include "segment/ocr/form_ib.h"
 
+#include "pylib_executor.h"
+#include "pylib_fork.h"
+#include "pylib_image_view.h"
+#include "pylib_json.h"
+#include "pylib_metrics.h"
+#include "pylib_parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 namespace py = pybind11;
 
 // ================
@@ -26,50 +41,294 @@ namespace py = pybind11;
 namespace maz {
 
     namespace {
-        
-        // Overload for nlohmann::json
-        py::object js2object(const serial::json_impl& j)
+
+        using ptr_ib_template = decltype(maz::forms::ib::form_template::create(
+            std::declval<const std::string&>(), std::declval<maz::doc::document&>()));
+        using ib_template_type = ptr_ib_template::element_type;
+
+        std::shared_ptr<maz::forms::ib::report> create_report_impl(
+            maz::doc::document& doc,
+            maz::la::ptr_columns pcols,
+            maz::la::ptr_gridline pgrid,
+            ptr_ib_template ptpl,
+            const maz::ia::image& imgb,
+            const std::string& dbg)
         {
-            if (j.is_null()) {
-                return py::none();
-            } else if (j.is_boolean()) {
-                return py::cast(j.get<bool>());
-            } else if (j.is_number_integer()) {
-                return py::cast(j.get<int64_t>());
-            } else if (j.is_number_unsigned()) {
-                return py::cast(j.get<uint64_t>());
-            } else if (j.is_number_float()) {
-                return py::cast(j.get<double>());
-            } else if (j.is_string()) {
-                return py::cast(j.get<std::string>());
-            } else if (j.is_array()) {
-                py::list list;
-                for (const auto& element : j) {
-                    list.append(js2object(element));
-                }
-                return list;
-            } else if (j.is_object()) {
-                py::dict dict;
-                for (auto it = j.begin(); it != j.end(); ++it) {
-                    dict[it.key().c_str()] = js2object(it.value());
-                }
-                return dict;
+            pylib::metrics_probe probe("create_report");
+
+            // we need shared_ptr, internally pixClone ensures we will not
+            // double free the memory
+            maz::ia::ptr_image pimg = std::make_shared<maz::ia::image>(imgb);
+
+            // create the report
+            return maz::forms::ib::report::create(doc, pcols, pgrid, ptpl, pimg, dbg);
+        }
+
+        /** Columns of the generic table layout of `page` inside `ib_bbox`, nullptr if not usable. */
+        maz::la::ptr_columns columns_from_table_impl(
+            maz::doc::page_type& page,
+            const ia::image& imgb,
+            const doc::bbox_type& ib_bbox,
+            const std::string& dbg)
+        {
+            if (!page.ia_elems().has("table_bbox")) return {};
+            if (!page.ia_elems().has("table_bboxes")) return {};
+
+            // stored as array
+            doc::bboxes_type table_bbox_arr = page.ia_elems().get("table_bbox")->bboxes();
+            if (1 != table_bbox_arr.size()) return {};
+            doc::bbox_type table_bbox = table_bbox_arr.front();
+
+            static constexpr size_t min_cols = maz::forms::ib::columns_from_text::min_cols;
+            doc::bboxes_type table_bboxes = page.ia_elems().get("table_bboxes")->bboxes();
+            if (table_bboxes.size() < min_cols) return {};
+
+            return maz::forms::ib::report::use_table_columns(
+                imgb, page.lines(), ib_bbox, table_bbox, table_bboxes, dbg
+            );
+        }
+
+        /**
+         * Whole template driven IB extraction of the last page of `doc` -
+         * the same stage sequence as the python flow (`create_report`,
+         * `find_columns`, `handle_corner_case`, `words_to_columns`,
+         * `best_columns`, `parse`, `save_ib_info`) gated by `is_allowed`.
+         * Without `pcols` the columns come from the table layout (when
+         * `pib_bbox` is given), `detect_columns` or empty `create_columns`.
+         * Runs without python objects so the caller can release the GIL.
+         */
+        struct ib_pipeline_result
+        {
+            std::shared_ptr<maz::forms::ib::report> preport;
+            maz::forms::ib::ptr_columns pib_cols;
+            std::vector<std::pair<std::string, double>> timing;
+
+            py::dict to_py() const
+            {
+                py::dict d;
+                d["report"] = preport ? py::cast(preport) : py::none();
+                d["columns"] = pib_cols ? py::cast(pib_cols) : py::none();
+                py::dict t;
+                for (const auto& kv : timing) t[kv.first.c_str()] = kv.second;
+                d["timing"] = t;
+                return d;
             }
-            return py::none();
+        };
+
+        class stage_timer
+        {
+        public:
+            explicit stage_timer(ib_pipeline_result& res) : res_(res) {}
+
+            template <typename F>
+            void operator()(const std::string& name, F&& fn)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                fn();
+                const std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+                res_.timing.emplace_back(name, took.count());
+            }
+
+        private:
+            ib_pipeline_result& res_;
+        };
+
+        ib_pipeline_result process_ib_impl(
+            maz::doc::document& doc,
+            const maz::ia::image& imgb,
+            maz::la::ptr_gridline pgrid,
+            ptr_ib_template ptpl,
+            maz::la::ptr_columns pcols,
+            const std::string& dbg,
+            const doc::bbox_type* pib_bbox)
+        {
+            using maz::forms::ib::form_template;
+            pylib::metrics_probe probe("process_ib");
+
+            ib_pipeline_result res;
+            stage_timer timed(res);
+            auto allowed = [&res](const std::string& key) {
+                auto preport_tpl = res.preport->ptemplate();
+                return !preport_tpl || preport_tpl->is_allowed(key);
+            };
+
+            if (!pcols && pib_bbox) {
+                timed("columns_from_table", [&]() {
+                    pcols = columns_from_table_impl(doc.last_page(), imgb, *pib_bbox, dbg);
+                });
+            }
+            if (!pcols) {
+                timed("detect_columns", [&]() {
+                    maz::ia::image imgb_ref(imgb);
+                    pcols = maz::forms::ib::report::detect_columns(imgb_ref, doc.last_page(), pgrid, -1, dbg);
+                    if (!pcols) {
+                        pcols = maz::la::columns::create(
+                            maz::forms::ib::columns_from_text::min_cols, doc.last_page());
+                    }
+                });
+            }
+
+            timed("create_report", [&]() {
+                res.preport = create_report_impl(doc, pcols, pgrid, ptpl, imgb, dbg);
+            });
+            if (!res.preport) return res;
+            maz::forms::ib::report& r = *res.preport;
+
+            maz::forms::ib::ptr_columns pib_cols;
+            if (allowed(form_template::step_find_columns))
+                timed("find_columns", [&]() { pib_cols = r.find_columns(); });
+            if (allowed(form_template::step_handle_corner_case))
+                timed("handle_corner_case", [&]() { pib_cols = r.handle_corner_case(pib_cols); });
+            if (allowed(form_template::step_words_to_columns))
+                timed("words_to_columns", [&]() { pib_cols = r.words_to_columns(pib_cols); });
+            if (allowed(form_template::step_best_columns))
+                timed("best_columns", [&]() { pib_cols = r.best_columns(pib_cols); });
+
+            if (allowed(form_template::step_parse)) {
+                timed("parse", [&]() {
+                    r.pre_parse(pib_cols);
+                    if (!pib_cols || 0 == pib_cols->known() || !r.parse(*pib_cols)) pib_cols.reset();
+                });
+            }
+
+            if (pib_cols) timed("save_ib_info", [&]() { r.save_ib_info(*pib_cols); });
+            res.pib_cols = pib_cols;
+            return res;
         }
-        
-        py::dict js2dict(const serial::json_dict& js_d)
+
+        /**
+         * Loaded ib_form classifier kept as a prototype, every evaluation runs on
+         * a copy so the configuration is read once and the model can be shared
+         * between threads.
+         */
+        class ib_form_model
         {
-            py::dict d;
-            if (js_d.is_object()) {
-                for (auto it = js_d.begin(); it != js_d.end(); ++it)
+        public:
+            using section_type = typename std::decay<decltype(
+                std::declval<maz::ml::classify::ib_form&>().get_ib_section())>::type;
+
+            struct result
+            {
+                bool is_ib = false;
+                std::string type;
+                section_type ib_section;
+                serial::json_dict features;
+
+                py::dict to_py() const
                 {
-                    d[it.key().c_str()] = js2object(it.value());
+                    py::dict d;
+                    d["is_ib"] = is_ib;
+                    d["type"] = type;
+                    d["ib_section"] = is_ib ? py::cast(ib_section) : py::none();
+                    d["features"] = pylib::js2object(features);
+                    return d;
                 }
+            };
+
+            explicit ib_form_model(const std::string& config_dir) : proto_(config_dir) {}
+
+            result evaluate(maz::doc::page_type& page) const
+            {
+                pylib::metrics_probe probe("ml_ib_form.evaluate");
+                maz::ml::classify::ib_form ibf(proto_);
+                ibf.process(page);
+                auto tp = ibf.type();
+
+                result res;
+                res.is_ib = tp.is_ib();
+                res.type = tp.str();
+                if (res.is_ib) res.ib_section = ibf.get_ib_section();
+                res.features = ibf.features::to_json(serial::normal);
+                return res;
             }
-            return d;
+
+            std::vector<result> evaluate_many(const std::vector<maz::doc::page_type*>& pages, size_t threads) const
+            {
+                std::vector<result> results(pages.size());
+                pylib::parallel_for(pages.size(), threads, [&](size_t i) {
+                    results[i] = evaluate(*pages[i]);
+                });
+                return results;
+            }
+
+        private:
+            maz::ml::classify::ib_form proto_;
+        };
+
+        /**
+         * UB04 classification with the preprocessing environment built once;
+         * `classify` copies only the env per call.
+         */
+        class ub04_classifier
+        {
+        public:
+            explicit ub04_classifier(const std::string& template_path) : template_path_(template_path)
+            {
+                maz::enable_image_operations(env_);
+                maz::update_to_defaults(env_);
+                maz::forms::ub::ub04::update_env_for_preprocess(env_);
+            }
+
+            /**
+             * With `in_place` the preprocessing works directly on `img` (which is
+             * then modified) instead of on a full copy.
+             */
+            std::shared_ptr<maz::forms::ub::ub04> classify(
+                ia::image& img, bool process_img, bool in_place, const std::string& dbg) const
+            {
+                pylib::metrics_probe probe("ub04_form.classify");
+                ia::ptr_image pimg;
+
+                if (process_img)
+                {
+                    env_type env(env_);
+                    doc::document doc_tmp(env, "");
+                    ia::image_variants doc_images;
+                    std::unique_ptr<ia::image> pimg_copy;
+                    if (!in_place) pimg_copy.reset(new ia::image(img.copy()));
+                    ia::image& img_tmp = in_place ? img : *pimg_copy;
+
+                    ia::image_properties img_props =
+                        maz::ocr::prepare_image_for_ocr(doc_tmp, env, doc_images, img_tmp, false, nullptr, dbg);
+                    pimg = doc_images.no_stickers_1bpp();
+                }
+                else
+                {
+                    // classification only reads the image, pixClone shares the pixels
+                    pimg = std::make_shared<ia::image>(img);
+                }
+
+                if (!pimg) return nullptr;
+
+                return maz::forms::ub::ub04::classify(*pimg, template_path_, dbg);
+            }
+
+            const std::string& template_path() const { return template_path_; }
+
+        private:
+            std::string template_path_;
+            env_type env_;
+        };
+
+        /** Classifier per template path for the static `ub04_form.classify`. */
+        const ub04_classifier& default_ub04_classifier(const std::string& template_path)
+        {
+            struct registry
+            {
+                registry() { pylib::fork_hooks().add_mutex(mtx); }
+
+                std::map<std::string, std::unique_ptr<ub04_classifier>> classifiers;
+                std::mutex mtx;
+            };
+            // intentionally leaked, registered in the fork hooks
+            static registry* preg = new registry();
+            std::lock_guard<std::mutex> lock(preg->mtx);
+            std::unique_ptr<ub04_classifier>& pcls = preg->classifiers[template_path];
+            if (!pcls) pcls.reset(new ub04_classifier(template_path));
+            return *pcls;
         }
-    }
+
+    } // namespace
 
     void init_forms(py::module& m)
     {
@@ -96,7 +355,45 @@ namespace maz {
             .def("json_features_s", [](maz::ml::classify::ib_form& self) -> std::string {
                 // call features::to_json
                 return self.features::to_json(serial::normal).dump(0);
-            });
+            })
+            .def("features_py", [](maz::ml::classify::ib_form& self) -> py::object {
+                return pylib::js2object(self.features::to_json(serial::normal));
+            }, "Features as python dict");
+
+        py::class_<ib_form_model, std::shared_ptr<ib_form_model>>(m, "ml_ib_form_model")
+            .def(py::init<const std::string&>(), py::arg("config_dir"), py::call_guard<py::gil_scoped_release>(),
+                "Load the IB form classifier once, evaluate pages with `process`/`process_many`")
+            .def("process", [](const ib_form_model& self, maz::doc::page_type& page) {
+                ib_form_model::result res;
+                {
+                    py::gil_scoped_release release;
+                    res = self.evaluate(page);
+                }
+                return res.to_py();
+            }, py::arg("page"),
+                "Classify a page, returns dict with is_ib, type, ib_section and features")
+            .def("process_many", [](const ib_form_model& self, const std::vector<maz::doc::page_type*>& pages, size_t threads) {
+                std::vector<ib_form_model::result> results;
+                {
+                    py::gil_scoped_release release;
+                    results = self.evaluate_many(pages, pylib::resolve_threads(threads));
+                }
+                py::list res(results.size());
+                for (size_t i = 0; i < results.size(); ++i) {
+                    res[i] = results[i].to_py();
+                }
+                return res;
+            }, py::arg("pages"), py::arg("threads") = 0,
+                "Classify all pages in one call on `threads` workers (0 = `get_threads()`), returns list of dicts")
+            .def("process_submit", [](py::object self_obj, pylib::executor& ex, py::object page_obj) {
+                const ib_form_model& self = self_obj.cast<const ib_form_model&>();
+                maz::doc::page_type& page = page_obj.cast<maz::doc::page_type&>();
+                return ex.submit([&self, &page]() -> pylib::executor::result_fn {
+                    auto pres = std::make_shared<ib_form_model::result>(self.evaluate(page));
+                    return [pres]() -> py::object { return pres->to_py(); };
+                }, py::make_tuple(self_obj, page_obj));
+            }, py::arg("executor"), py::arg("page"),
+                "Queue `process`, returns asyncio future of the result dict");
 
         py::class_<maz::forms::ib::page_segments_detector>(m, "ib_page_segments_detector")
             .def(py::init<const maz::doc::lines_type&, maz::doc::bboxes_type>())
@@ -119,36 +416,14 @@ namespace maz {
             .def("valid_perc", &maz::forms::ub::ub04::valid_perc)
             .def("bbox", &maz::forms::ub::ub04::bbox)
             .def_static("classify",
-                [](const ia::image& img,
+                [](ia::image& img,
                 const std::string& template_path,
                 bool process_img,
                 const std::string& dbg) -> std::shared_ptr<maz::forms::ub::ub04>
                 {
-                    ia::ptr_image pimg;
-
-                    if (process_img)
-                    {
-                        env_type env;
-                        maz::enable_image_operations(env);
-                        maz::update_to_defaults(env);
-                        maz::forms::ub::ub04::update_env_for_preprocess(env);
-
-                        doc::document doc_tmp(env, "");
-                        ia::image_variants doc_images;
-                        ia::image img_tmp(img.copy());
-
-                        ia::image_properties img_props =
-                            maz::ocr::prepare_image_for_ocr(doc_tmp, env, doc_images, img_tmp, false, nullptr, dbg);
-                        pimg = doc_images.no_stickers_1bpp();
-                    }
-                    else
-                    {
-                        pimg = ia::ptr_image(new ia::image(img.copy()));
-                    }
-
-                    if (!pimg) return nullptr;
-                  
-                    return maz::forms::ub::ub04::classify(*pimg, template_path, dbg);
+                    const ub04_classifier& cls = default_ub04_classifier(template_path);
+                    py::gil_scoped_release release;
+                    return cls.classify(img, process_img, false, dbg);
                 },
                 py::arg("img"),
                 py::arg("template_path"),
@@ -166,6 +441,34 @@ namespace maz {
                 })
             ;
 
+        py::class_<ub04_classifier, std::shared_ptr<ub04_classifier>>(m, "ub04_classifier")
+            .def(py::init<const std::string&>(), py::arg("template_path"),
+                "Reusable UB04 classifier - preprocessing environment is built once")
+            .def("classify",
+                [](const ub04_classifier& self, ia::image& img, bool process_img, bool in_place, const std::string& dbg)
+                {
+                    py::gil_scoped_release release;
+                    return self.classify(img, process_img, in_place, dbg);
+                },
+                py::arg("img"),
+                py::arg("process_img") = true,
+                py::arg("in_place") = false,
+                py::arg("dbg") = "",
+                "Classify UB04 form from image, `in_place` lets preprocessing modify `img` instead of copying it")
+            .def("classify",
+                [](const ub04_classifier& self, const pylib::image_view& view, bool process_img, const std::string& dbg)
+                {
+                    py::gil_scoped_release release;
+                    // the region copy is ours, preprocess it in place
+                    maz::ia::image img = view.materialize();
+                    return self.classify(img, process_img, true, dbg);
+                },
+                py::arg("view"),
+                py::arg("process_img") = true,
+                py::arg("dbg") = "",
+                "Classify UB04 form from the region of an image view")
+            .def("template_path", &ub04_classifier::template_path);
+
         m.def(
             "classify_ib_in_ub",
             [](const maz::doc::page_type& p, std::shared_ptr<maz::forms::ub::ub04> pform) -> py::dict
@@ -174,7 +477,7 @@ namespace maz {
                 ib_in_ub_classifier cls(p, pform); 
                 
                 auto js_d = cls.to_json(serial::detail::normal);
-                py::dict res = js2dict(js_d);
+                py::dict res = pylib::js2dict(js_d);
                 return res;
             },
             "Classify a form as UB with IB");
@@ -232,14 +535,37 @@ namespace maz {
 
         py::class_<maz::forms::ib::lines>(m, "lines")
             .def("__len__", &maz::forms::ib::lines::size)
-            .def("__getitem__", [](const maz::forms::ib::lines& ib_lines, size_t i) ->maz::forms::ib::line {
-                if (i >= ib_lines.size()) throw py::index_error();
-                    return *std::next(ib_lines.begin(), i);
-                }, py::return_value_policy::reference_internal)
+            .def("__getitem__", [](const maz::forms::ib::lines& ib_lines, py::ssize_t i) -> const maz::forms::ib::line& {
+                return *pylib::py_at(ib_lines, i);
+            }, py::return_value_policy::reference_internal)
+            .def("__iter__", [](const maz::forms::ib::lines& ib_lines) {
+                return py::make_iterator(ib_lines.begin(), ib_lines.end());
+            }, py::keep_alive<0, 1>())
+            .def("lines", [](py::object self) -> py::list {
+                // one walk, references kept alive by `self`
+                const maz::forms::ib::lines& ib_lines = self.cast<const maz::forms::ib::lines&>();
+                py::list res(ib_lines.size());
+                size_t i = 0;
+                for (const auto& l : ib_lines) {
+                    PyList_SET_ITEM(res.ptr(), i++,
+                        py::cast(&l, py::return_value_policy::reference_internal, self).release().ptr());
+                }
+                return res;
+            }, "All lines as list - use instead of repeated indexing")
+            .def("indexed", [](const maz::forms::ib::lines& ib_lines) {
+                return pylib::indexed<maz::forms::ib::lines>(ib_lines);
+            }, py::keep_alive<0, 1>(), "O(1) indexing of the lines while they are not modified")
             .def("all_size", &maz::forms::ib::lines::all_size)
             .def("ignored_size", &maz::forms::ib::lines::ignored_size)
         ;
 
+        py::class_<pylib::indexed<maz::forms::ib::lines>>(m, "lines_indexed")
+            .def("__len__", &pylib::indexed<maz::forms::ib::lines>::size)
+            .def("__getitem__", [](const pylib::indexed<maz::forms::ib::lines>& self, py::ssize_t i) -> const maz::forms::ib::line& {
+                return *self.at(i);
+            }, py::return_value_policy::reference_internal)
+        ;
+
         py::class_<maz::forms::ib::ub_parser>(m, "ub_parser")
             .def(py::init<maz::doc::document&, const bbox_type&>())
             .def("report", &maz::forms::ib::ub_parser::report)
@@ -308,6 +634,16 @@ namespace maz {
 
         // ============ 
 
+        py::class_<ib_template_type, ptr_ib_template>(m, "ib_form_template");
+
+        m.def(
+            "load_ib_form_template",
+            [](const std::string& template_path, maz::doc::document& doc) {
+                return maz::forms::ib::form_template::create(template_path, doc);
+            },
+            py::arg("template_path"), py::arg("doc"),
+            "Parse an IB form template for `doc` - reusable by the calls on that document");
+
         m.def(
             "create_report",
             [](maz::doc::document& doc,
@@ -318,16 +654,7 @@ namespace maz {
                 const std::string& dbg) -> std::shared_ptr<maz::forms::ib::report> 
             {
                     auto ptpl = maz::forms::ib::form_template::create(template_path, doc);
-
-                    // we need shared_ptr, internally pixClone ensures we will not
-                    // double free the memory
-                    maz::ia::ptr_image pimg = std::make_shared<maz::ia::image>(imgb);
-
-                    // create the report
-                    std::shared_ptr<maz::forms::ib::report> preport = maz::forms::ib::report::create(
-                        doc, pcols, pgrid, ptpl, pimg, dbg
-                    );
-                    return preport;
+                    return create_report_impl(doc, pcols, pgrid, ptpl, imgb, dbg);
             },
             py::arg("doc"), 
             py::arg("pcols"),
@@ -339,6 +666,115 @@ namespace maz {
             py::return_value_policy::copy
         );
 
+        m.def(
+            "create_report",
+            [](maz::doc::document& doc,
+                maz::la::ptr_columns pcols,
+                maz::la::ptr_gridline pgrid,
+                ptr_ib_template ptpl,
+                const maz::ia::image& imgb,
+                const std::string& dbg) -> std::shared_ptr<maz::forms::ib::report> 
+            {
+                    return create_report_impl(doc, pcols, pgrid, ptpl, imgb, dbg);
+            },
+            py::arg("doc"), 
+            py::arg("pcols"),
+            py::arg("pgrid"),
+            py::arg("template"),
+            py::arg("imgb"),
+            py::arg("dbg") = "",
+            "Initialize report from a preloaded template (see `load_ib_form_template`)",
+            py::return_value_policy::copy
+        );
+
+        m.def(
+            "process_ib",
+            [](maz::doc::document& doc,
+                const maz::ia::image& imgb,
+                maz::la::ptr_gridline pgrid,
+                ptr_ib_template ptpl,
+                maz::la::ptr_columns pcols,
+                const std::string& dbg,
+                const doc::bbox_type* pib_bbox) -> py::dict
+            {
+                ib_pipeline_result res;
+                {
+                    py::gil_scoped_release release;
+                    res = process_ib_impl(doc, imgb, pgrid, ptpl, pcols, dbg, pib_bbox);
+                }
+                return res.to_py();
+            },
+            py::arg("doc"),
+            py::arg("imgb"),
+            py::arg("pgrid"),
+            py::arg("template"),
+            py::arg("pcols") = nullptr,
+            py::arg("dbg") = "",
+            py::arg("ib_bbox") = nullptr,
+            "Run the whole IB extraction natively (when `pcols` is None the columns come from "
+            "`columns_from_table` with `ib_bbox`, else `detect_columns`, else `create_columns`), "
+            "returns dict with `report`, parsed `columns` (None on failure) and per stage `timing` [s]"
+        );
+
+        m.def(
+            "process_ib",
+            [](maz::doc::document& doc,
+                const maz::ia::image& imgb,
+                maz::la::ptr_gridline pgrid,
+                const std::string& template_path,
+                maz::la::ptr_columns pcols,
+                const std::string& dbg,
+                const doc::bbox_type* pib_bbox) -> py::dict
+            {
+                ib_pipeline_result res;
+                {
+                    py::gil_scoped_release release;
+                    auto ptpl = maz::forms::ib::form_template::create(template_path, doc);
+                    res = process_ib_impl(doc, imgb, pgrid, ptpl, pcols, dbg, pib_bbox);
+                }
+                return res.to_py();
+            },
+            py::arg("doc"),
+            py::arg("imgb"),
+            py::arg("pgrid"),
+            py::arg("template_path"),
+            py::arg("pcols") = nullptr,
+            py::arg("dbg") = "",
+            py::arg("ib_bbox") = nullptr,
+            "Like `process_ib` with the template parsed from `template_path` for `doc`"
+        );
+
+        m.def(
+            "process_ib_submit",
+            [](pylib::executor& ex,
+                py::object doc_obj,
+                py::object imgb_obj,
+                maz::la::ptr_gridline pgrid,
+                ptr_ib_template ptpl,
+                maz::la::ptr_columns pcols,
+                const std::string& dbg,
+                const doc::bbox_type* pib_bbox) -> py::object
+            {
+                maz::doc::document& doc = doc_obj.cast<maz::doc::document&>();
+                const maz::ia::image& imgb = imgb_obj.cast<const maz::ia::image&>();
+                std::shared_ptr<const doc::bbox_type> pbbox;
+                if (pib_bbox) pbbox = std::make_shared<const doc::bbox_type>(*pib_bbox);
+                return ex.submit([&doc, &imgb, pgrid, ptpl, pcols, dbg, pbbox]() -> pylib::executor::result_fn {
+                    auto pres = std::make_shared<ib_pipeline_result>(process_ib_impl(doc, imgb, pgrid, ptpl, pcols, dbg, pbbox.get()));
+                    return [pres]() -> py::object { return pres->to_py(); };
+                }, py::make_tuple(doc_obj, imgb_obj));
+            },
+            py::arg("executor"),
+            py::arg("doc"),
+            py::arg("imgb"),
+            py::arg("pgrid"),
+            py::arg("template"),
+            py::arg("pcols") = nullptr,
+            py::arg("dbg") = "",
+            py::arg("ib_bbox") = nullptr,
+            "Queue `process_ib`, returns asyncio future of its result dict"
+        );
+
         m.def(
             "create_columns",
             [](maz::doc::page_type& page) -> std::shared_ptr<maz::la::columns> {
@@ -369,6 +805,7 @@ namespace maz {
                 int line_h,
                 const std::string& dbg) -> std::shared_ptr<maz::la::columns> 
             {
+                pylib::metrics_probe probe("detect_columns");
                 return maz::forms::ib::report::detect_columns(imgb, page, pgrid, line_h, dbg);
             },
             py::arg("page"),
@@ -387,22 +824,7 @@ namespace maz {
                 const doc::bbox_type& ib_bbox, 
                 const std::string& dbg) -> std::shared_ptr<maz::la::columns> 
             {
-                if (!page.ia_elems().has("table_bbox")) return {};
-                if (!page.ia_elems().has("table_bboxes")) return {};
-
-                // stored as array
-                doc::bboxes_type table_bbox_arr = page.ia_elems().get("table_bbox")->bboxes();
-                if (1 != table_bbox_arr.size()) return {};
-                doc::bbox_type table_bbox = table_bbox_arr.front();
-
-                static constexpr size_t min_cols = maz::forms::ib::columns_from_text::min_cols;
-                doc::bboxes_type table_bboxes = page.ia_elems().get("table_bboxes")->bboxes();
-                if (table_bboxes.size() < min_cols) return {};
-
-                la::ptr_columns pcols = maz::forms::ib::report::use_table_columns(
-                    imgb, page.lines(), ib_bbox, table_bbox, table_bboxes, dbg
-                );
-                return pcols;
+                return columns_from_table_impl(page, imgb, ib_bbox, dbg);
             },
             py::arg("page"),
             py::arg("imgb"),
@@ -427,6 +849,12 @@ namespace maz {
             py::return_value_policy::copy
         );
 
+        m.def("subtypes_py", [](std::list<std::string> subtypes) -> py::object {
+                return pylib::js2object(maz::segment::ib::data::to_json(subtypes));
+            },
+            "Returns subtypes as python dict in the correct response format."
+        );
+
     }
 
 } // namespace maz
@@ -8,6 +8,13 @@
 
 #include "segment/segments/lines.h"
 
+#include "pylib_image_view.h"
+#include "pylib_metrics.h"
+#include "pylib_parallel.h"
+
+#include <algorithm>
+#include <vector>
+
 namespace py = pybind11;
 
 // ================
@@ -15,31 +22,114 @@ namespace py = pybind11;
 // clang-format off
 namespace maz {
 
+    namespace {
+
+        template <typename bboxes_container>
+        void offset_bboxes(bboxes_container& bboxes, double dx, double dy)
+        {
+            for (auto& b : bboxes) {
+                b = maz::bbox_type(b.xlt() + dx, b.ylt() + dy, b.xrb() + dx, b.yrb() + dy);
+            }
+        }
+
+        /** Lines of the whole image, binarized on a copy when needed. */
+        segment::lines::lines_info extract(const maz::ia::image& img, int letter_h, const std::string& dbg)
+        {
+            using namespace maz::segment;
+            if (!img.is_binary())
+            {
+                ia::ptr_image pimgb = img.binary_copy();
+                return lines::extract(*pimgb, letter_h, dbg);
+            }
+            return lines::extract(img, letter_h, dbg);
+        }
+
+        /**
+         * Lines of `img`, restricted to `roi` when it is not empty. The ROI is
+         * clamped to the image and clipped before binarization so only that
+         * part is copied, the returned lines are in `img` coordinates.
+         */
+        segment::lines::lines_info ia_lines_impl(
+            const maz::ia::image& img, int letter_h, const maz::bbox_type* roi, const std::string& dbg)
+        {
+            pylib::metrics_probe probe("ia_lines");
+
+            if (!roi || roi->width() <= 0 || roi->height() <= 0) return extract(img, letter_h, dbg);
+
+            const maz::bbox_type ib = img.bbox();
+            const maz::bbox_type area(
+                std::max(roi->xlt(), ib.xlt()), std::max(roi->ylt(), ib.ylt()),
+                std::min(roi->xrb(), ib.xrb()), std::min(roi->yrb(), ib.yrb()));
+            if (area.width() <= 0 || area.height() <= 0) return segment::lines::lines_info();
+
+            maz::ia::image img_roi = img.clip(area);
+            segment::lines::lines_info li = extract(img_roi, letter_h, dbg);
+            offset_bboxes(li.hlines, area.xlt(), area.ylt());
+            offset_bboxes(li.vlines, area.xlt(), area.ylt());
+            return li;
+        }
+
+    } // namespace
+
     void init_ia(py::module& m) 
     {
         // ============
 
         m.def(
             "ia_lines",
-            [](const maz::ia::image& imgb, int letter_h, const std::string& dbg)
+            [](const maz::ia::image& imgb, int letter_h, const std::string& dbg, const maz::bbox_type* roi)
             {
-                using namespace maz::segment;
-
-                lines::lines_info li;
-
-                if (!imgb.is_binary())
+                segment::lines::lines_info li;
                 {
-                    ia::ptr_image pimgb = imgb.binary_copy();
-                    li = lines::extract(*pimgb, letter_h, dbg);
+                    py::gil_scoped_release release;
+                    li = ia_lines_impl(imgb, letter_h, roi, dbg);
                 }
-                else
+                return make_tuple(li.hlines, li.vlines);
+            },
+            py::arg("imgb"),
+            py::arg("letter_h"),
+            py::arg("dbg") = "",
+            py::arg("roi") = nullptr,
+            "IA extract hlines/vlines, optionally only inside `roi` (lines are still in image coordinates)");
+
+        m.def(
+            "ia_lines",
+            [](const pylib::image_view& view, int letter_h, const std::string& dbg)
+            {
+                segment::lines::lines_info li;
                 {
-                    li = lines::extract(imgb, letter_h, dbg);
+                    py::gil_scoped_release release;
+                    li = ia_lines_impl(view.image(), letter_h, &view.bbox(), dbg);
                 }
-
                 return make_tuple(li.hlines, li.vlines);
             },
-            "IA extract hlines/vlines");
+            py::arg("view"),
+            py::arg("letter_h"),
+            py::arg("dbg") = "",
+            "IA extract hlines/vlines inside an image view (lines are in parent image coordinates)");
+
+        m.def(
+            "ia_lines_many",
+            [](const std::vector<const maz::ia::image*>& imgs, int letter_h, size_t threads, const std::string& dbg)
+            {
+                std::vector<segment::lines::lines_info> lis(imgs.size());
+                {
+                    py::gil_scoped_release release;
+                    pylib::parallel_for(imgs.size(), pylib::resolve_threads(threads), [&](size_t i) {
+                        lis[i] = ia_lines_impl(*imgs[i], letter_h, nullptr, dbg);
+                    });
+                }
+                py::list res(lis.size());
+                for (size_t i = 0; i < lis.size(); ++i) {
+                    res[i] = py::make_tuple(lis[i].hlines, lis[i].vlines);
+                }
+                return res;
+            },
+            py::arg("imgs"),
+            py::arg("letter_h"),
+            py::arg("threads") = 0,
+            py::arg("dbg") = "",
+            "`ia_lines` of many images in parallel, list of (hlines, vlines)");
     }
 
 } // namespace maz
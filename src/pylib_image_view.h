@@ -0,0 +1,49 @@
+#pragma once
+
+#include "image-analysis/image.h"
+
+#include <pybind11/pybind11.h>
+
+#include <stdexcept>
+#include <utility>
+
+namespace maz {
+namespace pylib {
+
+    /**
+     * Region of a page image without copying pixels. The view holds its own
+     * reference to the parent's pixels (`pixClone`), so it keeps the raster the
+     * parent had when the view was created - operations replacing the parent
+     * raster (e.g. `downscale2x`, `deskew`, `binarize_*`) do not change what the
+     * view sees and the bbox stays inside it. Pixels are copied (only the
+     * region) by `materialize` when a kernel needs a contiguous image.
+     */
+    class image_view
+    {
+    public:
+        image_view(pybind11::object parent, const maz::bbox_type& bbox)
+            : parent_(std::move(parent)), img_(parent_.cast<const maz::ia::image&>()), bbox_(bbox)
+        {
+            const maz::bbox_type img_bbox = img_.bbox();
+            if (bbox_.width() <= 0 || bbox_.height() <= 0 ||
+                bbox_.xlt() < img_bbox.xlt() || bbox_.ylt() < img_bbox.ylt() ||
+                bbox_.xrb() > img_bbox.xrb() || bbox_.yrb() > img_bbox.yrb())
+                throw std::invalid_argument("view bbox " + bbox_.to_string() + " outside of image " + img_bbox.to_string());
+        }
+
+        /** Pixels of the view's page image, safe to use without the GIL while the view lives. */
+        const maz::ia::image& image() const { return img_; }
+        const maz::bbox_type& bbox() const { return bbox_; }
+        const pybind11::object& parent() const { return parent_; }
+
+        maz::ia::image materialize() const { return img_.clip(bbox_); }
+
+    private:
+        pybind11::object parent_;
+        // shares the PIX with the parent
+        maz::ia::image img_;
+        maz::bbox_type bbox_;
+    };
+
+} // namespace pylib
+} // namespace maz
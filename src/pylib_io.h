@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace maz {
+namespace pylib {
+
+    /**
+     * Read-only memory mapping of a whole file, the file handle is kept
+     * open for the lifetime of the object.
+     */
+    class mapped_file
+    {
+    public:
+        explicit mapped_file(const std::string& filename)
+        {
+#ifdef _WIN32
+            hfile_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (INVALID_HANDLE_VALUE == hfile_) throw std::runtime_error("cannot open [" + filename + "]");
+            LARGE_INTEGER sz;
+            GetFileSizeEx(hfile_, &sz);
+            size_ = static_cast<size_t>(sz.QuadPart);
+            if (0 == size_) return;
+            hmap_ = CreateFileMappingA(hfile_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (hmap_) data_ = static_cast<const uint8_t*>(MapViewOfFile(hmap_, FILE_MAP_READ, 0, 0, 0));
+            if (!data_) {
+                close();
+                throw std::runtime_error("cannot map [" + filename + "]");
+            }
+#else
+            fd_ = ::open(filename.c_str(), O_RDONLY);
+            if (fd_ < 0) throw std::runtime_error("cannot open [" + filename + "]");
+            struct stat st;
+            if (0 != ::fstat(fd_, &st)) {
+                close();
+                throw std::runtime_error("cannot stat [" + filename + "]");
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (0 == size_) return;
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (MAP_FAILED == p) {
+                close();
+                throw std::runtime_error("cannot map [" + filename + "]");
+            }
+            data_ = static_cast<const uint8_t*>(p);
+#endif
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        ~mapped_file() { close(); }
+
+        const uint8_t* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        void close()
+        {
+#ifdef _WIN32
+            if (data_) UnmapViewOfFile(data_);
+            if (hmap_) CloseHandle(hmap_);
+            if (INVALID_HANDLE_VALUE != hfile_) CloseHandle(hfile_);
+            hmap_ = nullptr;
+            hfile_ = INVALID_HANDLE_VALUE;
+#else
+            if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+            if (0 <= fd_) ::close(fd_);
+            fd_ = -1;
+#endif
+            data_ = nullptr;
+        }
+
+#ifdef _WIN32
+        HANDLE hfile_ = INVALID_HANDLE_VALUE;
+        HANDLE hmap_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+        const uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+} // namespace pylib
+} // namespace maz
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "serialize/serialize.h"
+
+#include <pybind11/pybind11.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace maz {
+namespace pylib {
+
+    /**
+     * Build python objects directly from json (no string round trip).
+     * Lists are pre-sized and object keys are interned once per conversion,
+     * so arrays of similar objects share their key strings.
+     */
+    class json_to_py
+    {
+    public:
+        pybind11::object operator()(const serial::json_impl& j) { return convert(j); }
+
+    private:
+        using value_t = serial::json_impl::value_t;
+
+        pybind11::object convert(const serial::json_impl& j)
+        {
+            namespace py = pybind11;
+            switch (j.type()) {
+            case value_t::boolean:
+                return py::bool_(j.get<bool>());
+            case value_t::number_integer:
+                return py::int_(j.get<int64_t>());
+            case value_t::number_unsigned:
+                return py::int_(j.get<uint64_t>());
+            case value_t::number_float:
+                return py::float_(j.get<double>());
+            case value_t::string:
+                return py::str(j.get_ref<const std::string&>());
+            case value_t::array: {
+                py::list list(j.size());
+                size_t i = 0;
+                for (const auto& element : j) {
+                    PyList_SET_ITEM(list.ptr(), i++, convert(element).release().ptr());
+                }
+                return std::move(list);
+            }
+            case value_t::object: {
+                py::dict dict;
+                for (auto it = j.begin(); it != j.end(); ++it) {
+                    py::object val = convert(it.value());
+                    if (0 != PyDict_SetItem(dict.ptr(), key(it.key()).ptr(), val.ptr()))
+                        throw py::error_already_set();
+                }
+                return std::move(dict);
+            }
+            default:
+                return py::none();
+            }
+        }
+
+        const pybind11::object& key(const std::string& k)
+        {
+            auto it = keys_.find(k);
+            if (it != keys_.end()) return it->second;
+            PyObject* pkey = PyUnicode_FromStringAndSize(k.data(), static_cast<Py_ssize_t>(k.size()));
+            if (!pkey) throw pybind11::error_already_set();
+            PyUnicode_InternInPlace(&pkey);
+            return keys_.emplace(k, pybind11::reinterpret_steal<pybind11::object>(pkey)).first->second;
+        }
+
+        std::unordered_map<std::string, pybind11::object> keys_;
+    };
+
+    inline pybind11::object js2object(const serial::json_impl& j)
+    {
+        return json_to_py()(j);
+    }
+
+    /** Like `js2object` but always a dict (empty for non-objects). */
+    inline pybind11::dict js2dict(const serial::json_dict& js_d)
+    {
+        if (!js_d.is_object()) return pybind11::dict();
+        return pybind11::reinterpret_borrow<pybind11::dict>(js2object(js_d));
+    }
+
+    /** Shortest `repr` of a double as python prints it (`0.1`, `1.0`, `1e-05`, `1e+16`). */
+    inline std::string py_float_repr(double d)
+    {
+        if (std::isnan(d)) return "nan";
+        if (std::isinf(d)) return d < 0 ? "-inf" : "inf";
+
+        // shortest round-trip scientific form
+        char buf[32];
+        for (int prec = 0; prec < 17; ++prec) {
+            std::snprintf(buf, sizeof(buf), "%.*e", prec, d);
+            if (std::strtod(buf, nullptr) == d) break;
+        }
+        std::string sci(buf);
+        const size_t e_pos = sci.find('e');
+        const int exp = std::atoi(sci.c_str() + e_pos + 1);
+        std::string digits;
+        bool neg = false;
+        for (size_t i = 0; i < e_pos; ++i) {
+            if ('-' == sci[i]) neg = true;
+            else if (std::isdigit(static_cast<unsigned char>(sci[i]))) digits += sci[i];
+        }
+        while (1 < digits.size() && '0' == digits.back()) digits.pop_back();
+
+        std::string res = neg ? "-" : "";
+        if (exp < -4 || 16 <= exp) {
+            res += digits.substr(0, 1);
+            if (1 < digits.size()) res += "." + digits.substr(1);
+            char e_buf[8];
+            std::snprintf(e_buf, sizeof(e_buf), "e%c%02d", exp < 0 ? '-' : '+', exp < 0 ? -exp : exp);
+            return res + e_buf;
+        }
+        if (exp < 0) return res + "0." + std::string(-exp - 1, '0') + digits;
+        const size_t int_len = static_cast<size_t>(exp) + 1;
+        if (digits.size() <= int_len) return res + digits + std::string(int_len - digits.size(), '0') + ".0";
+        return res + digits.substr(0, int_len) + "." + digits.substr(int_len);
+    }
+
+    /** Scalar json value formatted like python `str()` of the value `json.load` returns. */
+    inline std::string py_str(const serial::json_impl& j)
+    {
+        using value_t = serial::json_impl::value_t;
+        switch (j.type()) {
+        case value_t::string:
+            return j.get<std::string>();
+        case value_t::boolean:
+            return j.get<bool>() ? "True" : "False";
+        case value_t::null:
+            return "None";
+        case value_t::number_integer:
+            return std::to_string(j.get<int64_t>());
+        case value_t::number_unsigned:
+            return std::to_string(j.get<uint64_t>());
+        case value_t::number_float:
+            return py_float_repr(j.get<double>());
+        default:
+            // python would format containers with its own repr, engines take scalars only
+            throw std::invalid_argument("engine parameter must be a scalar, got " + j.dump());
+        }
+    }
+
+} // namespace pylib
+} // namespace maz
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "io-document/io-document.h"
+#include "serialize/serialize.h"
+
+#include "pylib.h"
+#include "pylib_fork.h"
+#include "pylib_io.h"
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace maz {
+namespace pylib {
+
+    /**
+     * Document json indexed by one structural scan; a page is parsed and
+     * materialized (as a single page document) only when accessed.
+     *
+     * All top-level keys except `pages_key` are parsed eagerly and shared by
+     * every page document.
+     */
+    class lazy_document
+    {
+    public:
+        explicit lazy_document(const maz_env_type& env, const std::string& pages_key = "pages")
+            : env_(env), pages_key_(pages_key)
+        {
+            // held while a page is parsed without the GIL
+            fork_id_ = fork_hooks().add_mutex(mtx_);
+        }
+
+        lazy_document(const lazy_document&) = delete;
+        lazy_document& operator=(const lazy_document&) = delete;
+
+        ~lazy_document() { fork_hooks().remove(fork_id_); }
+
+        /** Index a json string - a document is loaded once, page references stay valid. */
+        void from_str(std::string js_str)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            check_not_loaded();
+            text_ = std::move(js_str);
+            index(text_.data(), text_.size());
+            loaded_ = true;
+        }
+
+        /** Index a json file kept memory mapped. */
+        void from_file(const std::string& filename)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            check_not_loaded();
+            pfile_.reset(new mapped_file(filename));
+            index(reinterpret_cast<const char*>(pfile_->data()), pfile_->size());
+            loaded_ = true;
+        }
+
+        size_t page_len() const
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            return pages_.size();
+        }
+
+        /** Single page document holding page `i` - parsed on first access. */
+        maz::doc::document& page_document(size_t i)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (i >= pages_.size()) throw std::out_of_range("page index out of range");
+            if (!docs_[i]) {
+                serial::json_dict js = header_;
+                serial::json_impl page_js = serial::json_impl::parse(data_ + pages_[i].first, data_ + pages_[i].second);
+                js[pages_key_] = serial::json_impl::array();
+                js[pages_key_].push_back(std::move(page_js));
+                std::unique_ptr<maz::doc::document> pdoc(new maz::doc::document(env_));
+                pdoc->from_json(js);
+                docs_[i] = std::move(pdoc);
+            }
+            return *docs_[i];
+        }
+
+        const maz::doc::page_type& page(size_t i)
+        {
+            return page_document(i).last_page();
+        }
+
+    private:
+        using span = std::pair<size_t, size_t>;
+
+        /** Reloading would free the pages returned so far. */
+        void check_not_loaded() const
+        {
+            if (loaded_) throw std::logic_error("lazy_document is already loaded, create a new one");
+        }
+
+        void index(const char* data, size_t size)
+        {
+            data_ = data;
+            size_ = size;
+            header_ = serial::json_impl::object();
+            pages_.clear();
+            docs_.clear();
+
+            size_t pos = skip_ws(0);
+            expect(pos, '{');
+            pos = skip_ws(pos + 1);
+            while (pos < size_ && '}' != data_[pos]) {
+                const size_t k_end = skip_string(pos);
+                const std::string key = serial::json_impl::parse(data_ + pos, data_ + k_end).get<std::string>();
+                pos = skip_ws(k_end);
+                expect(pos, ':');
+                pos = skip_ws(pos + 1);
+
+                if (key == pages_key_ && pos < size_ && '[' == data_[pos]) {
+                    pos = skip_ws(pos + 1);
+                    while (pos < size_ && ']' != data_[pos]) {
+                        const size_t v_end = skip_value(pos);
+                        pages_.emplace_back(pos, v_end);
+                        pos = skip_ws(v_end);
+                        if (pos < size_ && ',' == data_[pos]) pos = skip_ws(pos + 1);
+                    }
+                    expect(pos, ']');
+                    pos = skip_ws(pos + 1);
+                } else {
+                    const size_t v_end = skip_value(pos);
+                    header_[key] = serial::json_impl::parse(data_ + pos, data_ + v_end);
+                    pos = skip_ws(v_end);
+                }
+                if (pos < size_ && ',' == data_[pos]) pos = skip_ws(pos + 1);
+            }
+            expect(pos, '}');
+            docs_.resize(pages_.size());
+        }
+
+        void expect(size_t pos, char c) const
+        {
+            if (pos >= size_ || c != data_[pos])
+                throw std::invalid_argument("invalid document json at offset " + std::to_string(pos));
+        }
+
+        size_t skip_ws(size_t pos) const
+        {
+            while (pos < size_ && (' ' == data_[pos] || '\n' == data_[pos] || '\r' == data_[pos] || '\t' == data_[pos])) ++pos;
+            return pos;
+        }
+
+        /** `pos` at the opening quote, returns position after the closing one. */
+        size_t skip_string(size_t pos) const
+        {
+            expect(pos, '"');
+            for (++pos; pos < size_; ++pos) {
+                if ('\\' == data_[pos]) ++pos;
+                else if ('"' == data_[pos]) return pos + 1;
+            }
+            throw std::invalid_argument("unterminated string in document json");
+        }
+
+        /** Returns position right after the value starting at `pos`. */
+        size_t skip_value(size_t pos) const
+        {
+            if (pos >= size_) throw std::invalid_argument("unexpected end of document json");
+            if ('"' == data_[pos]) return skip_string(pos);
+            if ('{' != data_[pos] && '[' != data_[pos]) {
+                while (pos < size_ && ',' != data_[pos] && '}' != data_[pos] && ']' != data_[pos] &&
+                       ' ' != data_[pos] && '\n' != data_[pos] && '\r' != data_[pos] && '\t' != data_[pos]) ++pos;
+                return pos;
+            }
+            size_t depth = 0;
+            while (pos < size_) {
+                const char c = data_[pos];
+                if ('"' == c) {
+                    pos = skip_string(pos);
+                    continue;
+                }
+                if ('{' == c || '[' == c) ++depth;
+                else if (('}' == c || ']' == c) && 0 == --depth) return pos + 1;
+                ++pos;
+            }
+            throw std::invalid_argument("unterminated value in document json");
+        }
+
+        maz_env_type env_;
+        std::string pages_key_;
+
+        std::string text_;
+        std::unique_ptr<mapped_file> pfile_;
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+
+        serial::json_dict header_;
+        std::vector<span> pages_;
+        std::vector<std::unique_ptr<maz::doc::document>> docs_;
+        bool loaded_ = false;
+        mutable std::mutex mtx_;
+        size_t fork_id_ = 0;
+    };
+
+} // namespace pylib
+} // namespace maz
@@ -15,6 +15,29 @@
 #include "os/version.h"
 #include "serialize/serialize.h"
 
+#include "pylib_executor.h"
+#include "pylib_fork.h"
+#include "pylib_image_view.h"
+#include "pylib_io.h"
+#include "pylib_json.h"
+#include "pylib_lazy_document.h"
+#include "pylib_metrics.h"
+#include "pylib_parallel.h"
+
+#include <pybind11/numpy.h>
+
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <set>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
 namespace py = pybind11;
 
 // ================
@@ -22,6 +45,507 @@ namespace py = pybind11;
 // clang-format off
 namespace maz {
 
+    namespace {
+
+        /**
+         * Fill a new PIX from a uint8 buffer (e.g. numpy/opencv array) in one pass:
+         *  - (h, w)          8bpp gray
+         *  - (h, w, 3|4)     32bpp rgb, channel order bgr(a) as in opencv unless `bgr` is false
+         *  - (h, ceil(w/8))  with `bpp` 1 - rows packed as by `numpy.packbits`, 1 is foreground
+         *
+         * Leptonica keeps pixels in native-endian 32bit words so the buffer
+         * cannot be shared on little-endian machines; rows are copied as bytes
+         * and swapped once.
+         */
+        PIX* buffer_to_pix(const py::buffer_info& info, int bpp, int width, bool bgr)
+        {
+            if (info.itemsize != 1 || info.format != py::format_descriptor<uint8_t>::format())
+                throw std::invalid_argument("image buffer must be uint8");
+            if (info.ndim != 2 && info.ndim != 3)
+                throw std::invalid_argument("image buffer must have 2 or 3 dimensions");
+
+            const int h = static_cast<int>(info.shape[0]);
+            const int cols = static_cast<int>(info.shape[1]);
+            const int channels = (3 == info.ndim) ? static_cast<int>(info.shape[2]) : 1;
+            const py::ssize_t row_stride = info.strides[0];
+            const py::ssize_t col_stride = info.strides[1];
+            const py::ssize_t ch_stride = (3 == info.ndim) ? info.strides[2] : 0;
+            const uint8_t* src = static_cast<const uint8_t*>(info.ptr);
+
+            if (1 == bpp) {
+                if (1 != channels) throw std::invalid_argument("1bpp buffer must have 2 dimensions");
+                if (width <= 0) width = cols * 8;
+                if ((width + 7) / 8 != cols) throw std::invalid_argument("1bpp width does not match packed row size");
+            } else if (8 == bpp || 0 == bpp) {
+                width = cols;
+                bpp = (1 == channels) ? 8 : 32;
+                if (1 != channels && 3 != channels && 4 != channels)
+                    throw std::invalid_argument("image buffer must have 1, 3 or 4 channels");
+            } else {
+                throw std::invalid_argument("supported bpp values are 1 and 8");
+            }
+
+            PIX* pix = pixCreate(width, h, bpp);
+            if (!pix) throw std::runtime_error("cannot allocate image");
+            l_uint32* data = pixGetData(pix);
+            const l_int32 wpl = pixGetWpl(pix);
+
+            for (int y = 0; y < h; ++y) {
+                const uint8_t* row = src + y * row_stride;
+                l_uint32* line = data + y * wpl;
+                if (32 != bpp) {
+                    // byte stream in big-endian word order, swapped below
+                    uint8_t* dst = reinterpret_cast<uint8_t*>(line);
+                    if (1 == col_stride) {
+                        std::memcpy(dst, row, cols);
+                    } else {
+                        for (int x = 0; x < cols; ++x) dst[x] = row[x * col_stride];
+                    }
+                    continue;
+                }
+                const int ri = bgr ? 2 : 0;
+                const int bi = bgr ? 0 : 2;
+                for (int x = 0; x < cols; ++x) {
+                    const uint8_t* px = row + x * col_stride;
+                    l_uint32 val;
+                    composeRGBPixel(px[ri * ch_stride], px[ch_stride], px[bi * ch_stride], &val);
+                    line[x] = val;
+                }
+            }
+
+            if (32 != bpp) pixEndianByteSwap(pix);
+            if (1 == bpp) pixSetPadBits(pix, 0);
+            return pix;
+        }
+
+        /** Copy pixels into a natural-layout uint8 array, inverse of `buffer_to_pix`. */
+        py::array pix_to_array(PIX* pix_src, bool bgr)
+        {
+            PIX* pix = pixClone(pix_src);
+            if (pixGetColormap(pix) || (1 != pixGetDepth(pix) && 8 != pixGetDepth(pix) && 32 != pixGetDepth(pix))) {
+                PIX* pix_conv = pixConvertTo8(pix, FALSE);
+                pixDestroy(&pix);
+                if (!pix_conv) throw std::runtime_error("cannot convert image to 8bpp");
+                pix = pix_conv;
+            }
+
+            const int w = pixGetWidth(pix);
+            const int h = pixGetHeight(pix);
+            const int d = pixGetDepth(pix);
+            const l_uint32* data = pixGetData(pix);
+            const l_int32 wpl = pixGetWpl(pix);
+
+            std::vector<py::ssize_t> shape;
+            if (1 == d) shape = {h, (w + 7) / 8};
+            else if (8 == d) shape = {h, w};
+            else shape = {h, w, 3};
+
+            py::array_t<uint8_t> arr(shape);
+            uint8_t* dst = arr.mutable_data();
+            for (int y = 0; y < h; ++y) {
+                const l_uint32* line = data + y * wpl;
+                if (32 != d) {
+                    const int cols = static_cast<int>(shape[1]);
+                    for (int x = 0; x < cols; ++x) *dst++ = GET_DATA_BYTE(line, x);
+                    continue;
+                }
+                for (int x = 0; x < w; ++x) {
+                    l_int32 r, g, b;
+                    extractRGBValues(line[x], &r, &g, &b);
+                    *dst++ = static_cast<uint8_t>(bgr ? b : r);
+                    *dst++ = static_cast<uint8_t>(g);
+                    *dst++ = static_cast<uint8_t>(bgr ? r : b);
+                }
+            }
+
+            pixDestroy(&pix);
+            return arr;
+        }
+
+        /** Data of a C-contiguous python buffer - encoded data is read linearly. */
+        const uint8_t* contiguous_data(const py::buffer_info& info)
+        {
+            py::ssize_t stride = info.itemsize;
+            for (size_t i = info.ndim; i-- > 0;) {
+                if (1 < info.shape[i] && stride != info.strides[i])
+                    throw std::invalid_argument("buffer must be C-contiguous");
+                stride *= info.shape[i];
+            }
+            return static_cast<const uint8_t*>(info.ptr);
+        }
+
+        /** Decode encoded image bytes (png, tiff, jpeg, ...) straight from memory. */
+        PIX* decode_pix(const uint8_t* data, size_t size, const std::string& format_hint)
+        {
+            // format detection reads the first 12 bytes
+            if (size < 12) throw std::invalid_argument(fmt::format("image data too short [{}B]", size));
+            if (!format_hint.empty()) {
+                l_int32 format = IFF_UNKNOWN;
+                findFileFormatBuffer(data, &format);
+                const bool tiff = (IFF_TIFF <= format && format <= IFF_TIFF_ZIP) || IFF_TIFF_JPEG == format;
+                const std::string& h = format_hint;
+                const bool ok =
+                    (h.find("png") != std::string::npos && IFF_PNG == format) ||
+                    (h.find("tif") != std::string::npos && tiff) ||
+                    ((h.find("jpeg") != std::string::npos || h.find("jpg") != std::string::npos) && IFF_JFIF_JPEG == format) ||
+                    (h.find("bmp") != std::string::npos && IFF_BMP == format);
+                if (!ok) throw std::invalid_argument(fmt::format("image data does not match format [{}]", format_hint));
+            }
+            PIX* pix = pixReadMem(data, size);
+            if (!pix) throw std::invalid_argument("cannot decode image data");
+            return pix;
+        }
+
+        /** Decode base64 (whitespace is skipped) into `dst` sized at least 3/4 of `src`, returns length. */
+        size_t base64_decode(const std::string& src, uint8_t* dst)
+        {
+            static const auto table = []() {
+                std::array<int8_t, 256> t;
+                t.fill(-1);
+                const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+                for (int i = 0; i < 64; ++i) t[static_cast<uint8_t>(alphabet[i])] = static_cast<int8_t>(i);
+                return t;
+            }();
+
+            size_t n = 0;
+            uint32_t acc = 0;
+            int bits = 0;
+            for (unsigned char c : src) {
+                if ('=' == c) break;
+                const int8_t v = table[c];
+                if (v < 0) {
+                    if (std::isspace(c)) continue;
+                    throw std::invalid_argument("invalid base64 image data");
+                }
+                acc = (acc << 6) | static_cast<uint32_t>(v);
+                bits += 6;
+                if (bits >= 8) {
+                    bits -= 8;
+                    dst[n++] = static_cast<uint8_t>(acc >> bits);
+                }
+            }
+            return n;
+        }
+
+        /** Number of IFDs (pages) in a classic tiff, only headers are read. */
+        size_t tiff_page_count(const uint8_t* d, size_t n)
+        {
+            if (n < 8) return 0;
+            const bool le = ('I' == d[0] && 'I' == d[1]);
+            auto rd16 = [d, le](size_t off) -> uint32_t {
+                return le ? (d[off] | d[off + 1] << 8) : (d[off] << 8 | d[off + 1]);
+            };
+            auto rd32 = [d, le](size_t off) -> uint32_t {
+                return le ? (d[off] | d[off + 1] << 8 | d[off + 2] << 16 | static_cast<uint32_t>(d[off + 3]) << 24)
+                          : (static_cast<uint32_t>(d[off]) << 24 | d[off + 1] << 16 | d[off + 2] << 8 | d[off + 3]);
+            };
+            // 43 is BigTIFF which leptonica does not read either
+            if (42 != rd16(2)) return 0;
+
+            size_t count = 0;
+            size_t off = rd32(4);
+            // bound the walk in case of cyclic offsets
+            while (0 != off && off + 2 <= n && count < n / 12) {
+                ++count;
+                const size_t next = off + 2 + rd16(off) * 12;
+                if (next + 4 > n) break;
+                off = rd32(next);
+            }
+            return count;
+        }
+
+        /**
+         * Pages of a (multi-page) image decoded lazily from one memory-mapped
+         * file; when iterating, the next page is decoded in the background.
+         * Calls from several threads are serialized, they share one cursor.
+         */
+        class image_reader
+        {
+        public:
+            image_reader(const std::string& filename, bool prefetch)
+                : file_(filename), prefetch_(prefetch)
+            {
+                l_int32 format = IFF_UNKNOWN;
+                if (12 <= file_.size()) findFileFormatBuffer(file_.data(), &format);
+                tiff_ = (IFF_TIFF <= format && format <= IFF_TIFF_ZIP) || IFF_TIFF_JPEG == format;
+                if (tiff_) {
+                    pages_ = tiff_page_count(file_.data(), file_.size());
+                } else if (IFF_UNKNOWN != format) {
+                    pages_ = 1;
+                } else {
+                    // e.g. pdf - only `image(filename, page)` handles it
+                    throw std::invalid_argument(fmt::format("unsupported image format [{}]", filename));
+                }
+                // the prefetch thread does not exist in a forked child, finish it before
+                fork_id_ = pylib::fork_hooks().add(
+                    [this]() {
+                        mtx_.lock();
+                        drop_prefetched();
+                    },
+                    [this]() { mtx_.unlock(); },
+                    [this]() { mtx_.unlock(); });
+            }
+
+            image_reader(const image_reader&) = delete;
+            image_reader& operator=(const image_reader&) = delete;
+
+            ~image_reader()
+            {
+                pylib::fork_hooks().remove(fork_id_);
+                drop_prefetched();
+            }
+
+            size_t size() const { return pages_; }
+
+            /** Decode 0-based page `i` - call without the GIL. */
+            PIX* page(size_t i)
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                return page_locked(i);
+            }
+
+            /** Next page of the iteration or nullptr - call without the GIL. */
+            PIX* next()
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (cursor_ >= pages_) return nullptr;
+                PIX* pix = page_locked(cursor_++);
+                if (prefetch_ && cursor_ < pages_) {
+                    const size_t idx = cursor_;
+                    pending_idx_ = idx;
+                    pending_ = std::async(std::launch::async, [this, idx]() { return decode(idx); });
+                }
+                return pix;
+            }
+
+            /** Restart the iteration - call without the GIL. */
+            void rewind()
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                cursor_ = 0;
+            }
+
+        private:
+            PIX* page_locked(size_t i)
+            {
+                if (pending_.valid() && pending_idx_ == i) return pending_.get();
+                drop_prefetched();
+                return decode(i);
+            }
+
+            PIX* decode(size_t i) const
+            {
+                PIX* pix = tiff_
+                    ? pixReadMemTiff(file_.data(), file_.size(), static_cast<l_int32>(i))
+                    : pixReadMem(file_.data(), file_.size());
+                if (!pix) throw std::runtime_error(fmt::format("cannot decode page [{}]", i + 1));
+                return pix;
+            }
+
+            void drop_prefetched()
+            {
+                if (!pending_.valid()) return;
+                try {
+                    PIX* pix = pending_.get();
+                    pixDestroy(&pix);
+                } catch (const std::exception&) {
+                    // reported again if the page is requested
+                }
+            }
+
+            pylib::mapped_file file_;
+            bool prefetch_;
+            bool tiff_ = false;
+            size_t pages_ = 0;
+            size_t cursor_ = 0;
+            std::future<PIX*> pending_;
+            size_t pending_idx_ = 0;
+            // guards the cursor and the prefetched page
+            std::mutex mtx_;
+            size_t fork_id_ = 0;
+        };
+
+        /** Binary json encodings nlohmann::json handles natively. */
+        std::vector<uint8_t> json_to_binary(const serial::json_impl& js, const std::string& format)
+        {
+            if ("cbor" == format) return serial::json_impl::to_cbor(js);
+            if ("msgpack" == format) return serial::json_impl::to_msgpack(js);
+            throw std::invalid_argument(fmt::format("unknown binary format [{}], use cbor or msgpack", format));
+        }
+
+        serial::json_impl json_from_binary(const uint8_t* data, size_t size, const std::string& format)
+        {
+            if ("cbor" == format) return serial::json_impl::from_cbor(data, data + size);
+            if ("msgpack" == format) return serial::json_impl::from_msgpack(data, data + size);
+            throw std::invalid_argument(fmt::format("unknown binary format [{}], use cbor or msgpack", format));
+        }
+
+        doc::bboxes_type page_ia_bboxes(const maz::doc::page_type& page, const std::string& key)
+        {
+            if (!page.ia_elems().has(key)) return {};
+            return page.ia_elems().get(key)->bboxes();
+        }
+
+        doc::bboxes_type page_hlines(const maz::doc::page_type& page)
+        {
+            // get hlines from IA
+            return page_ia_bboxes(page, "hlines");
+        }
+
+        doc::bboxes_type page_vlines(const maz::doc::page_type& page)
+        {
+            // get vlines only if table
+            if (!page.ia_elems().has("table_bbox")) return {};
+            // form_ib.cpp:post_process:185
+            return page.ia_elems().get("vlines")->bboxes();
+        }
+
+        /** (N, 4) float64 array of xlt, ylt, xrb, yrb. */
+        template <typename bbox_container>
+        py::array_t<double> bboxes_to_array(const bbox_container& bboxes)
+        {
+            py::array_t<double> arr({static_cast<py::ssize_t>(bboxes.size()), static_cast<py::ssize_t>(4)});
+            double* p = arr.mutable_data();
+            for (const auto& b : bboxes) {
+                *p++ = b.xlt();
+                *p++ = b.ylt();
+                *p++ = b.xrb();
+                *p++ = b.yrb();
+            }
+            return arr;
+        }
+
+        /** Numeric word ids as an int64 array. */
+        template <typename id_type>
+        py::object word_ids_to_py(const std::vector<id_type>& ids, std::true_type)
+        {
+            py::array_t<int64_t> arr(static_cast<py::ssize_t>(ids.size()));
+            int64_t* p = arr.mutable_data();
+            for (const auto& id : ids) *p++ = static_cast<int64_t>(id);
+            return arr;
+        }
+
+        /** Other word ids (e.g. strings) as a list. */
+        template <typename id_type>
+        py::object word_ids_to_py(const std::vector<id_type>& ids, std::false_type)
+        {
+            return py::cast(ids);
+        }
+
+        /** Columnar word (and line) data of a page filled in one pass. */
+        py::dict page_to_arrays(const maz::doc::page_type& page)
+        {
+            const auto& lines = page.lines();
+            py::ssize_t n = 0;
+            for (const auto& pline : lines) n += static_cast<py::ssize_t>(pline->size());
+            const py::ssize_t n_lines = static_cast<py::ssize_t>(lines.size());
+
+            py::array_t<double> bbox({n, static_cast<py::ssize_t>(4)});
+            py::array_t<double> conf(n);
+            py::array_t<int32_t> line_idx(n);
+            py::array_t<int32_t> word_idx(n);
+            py::array_t<int32_t> orientation(n);
+            py::array_t<int64_t> text_offsets(n + 1);
+            py::array_t<double> line_bbox({n_lines, static_cast<py::ssize_t>(4)});
+            using word_id_type = std::decay<decltype(maz::doc::word_type::id)>::type;
+            std::vector<word_id_type> ids;
+            ids.reserve(static_cast<size_t>(n));
+            std::string text;
+
+            double* pbbox = bbox.mutable_data();
+            double* pconf = conf.mutable_data();
+            int32_t* pline_idx = line_idx.mutable_data();
+            int32_t* pword_idx = word_idx.mutable_data();
+            int32_t* porientation = orientation.mutable_data();
+            int64_t* poffsets = text_offsets.mutable_data();
+            double* pline_bbox = line_bbox.mutable_data();
+
+            int32_t li = 0;
+            *poffsets++ = 0;
+            for (const auto& pline : lines) {
+                *pline_bbox++ = pline->bbox.xlt();
+                *pline_bbox++ = pline->bbox.ylt();
+                *pline_bbox++ = pline->bbox.xrb();
+                *pline_bbox++ = pline->bbox.yrb();
+                int32_t wi = 0;
+                for (const auto& pw : *pline) {
+                    *pbbox++ = pw->bbox.xlt();
+                    *pbbox++ = pw->bbox.ylt();
+                    *pbbox++ = pw->bbox.xrb();
+                    *pbbox++ = pw->bbox.yrb();
+                    *pconf++ = pw->conf();
+                    *pline_idx++ = li;
+                    *pword_idx++ = wi++;
+                    ids.push_back(pw->id);
+                    *porientation++ = static_cast<int32_t>(pw->orientation);
+                    text += pw->text;
+                    *poffsets++ = static_cast<int64_t>(text.size());
+                }
+                ++li;
+            }
+
+            py::dict res;
+            res["bbox"] = bbox;
+            res["conf"] = conf;
+            res["line"] = line_idx;
+            res["word"] = word_idx;
+            res["id"] = word_ids_to_py(ids, std::is_arithmetic<word_id_type>());
+            res["orientation"] = orientation;
+            res["text_offsets"] = text_offsets;
+            res["text"] = py::bytes(text);
+            res["line_bbox"] = line_bbox;
+            return res;
+        }
+
+        void check_page_image(maz::doc::page_type& page, const std::string& key)
+        {
+            if (!page.images().has(key)) throw py::key_error(key);
+        }
+
+        using image_op = std::function<void(maz::ia::image&)>;
+
+        /** In-place image operations usable in `image_ops_many`. */
+        image_op find_image_op(const std::string& name)
+        {
+            static const std::map<std::string, image_op> ops = {
+                {"to8bpp", [](maz::ia::image& img) { img.to8bpp(true); }},
+                {"deskew", [](maz::ia::image& img) { img.deskew(); }},
+                {"invert", [](maz::ia::image& img) { img.invert(); }},
+                {"binarize_otsu", [](maz::ia::image& img) { img.binarize_otsu(); }},
+                {"binarize_sauvola", [](maz::ia::image& img) { img.binarize_sauvola(); }},
+                {"downscale2x", [](maz::ia::image& img) { img.downscale2x(); }},
+                {"upscale2x", [](maz::ia::image& img) { img.upscale2x(); }},
+                {"enhance", [](maz::ia::image& img) { img.enhance(); }},
+            };
+            auto it = ops.find(name);
+            if (it == ops.end()) throw std::invalid_argument("unknown image operation [" + name + "]");
+            return it->second;
+        }
+
+        /**
+         * Apply `ops` in order to every image, images are processed in parallel
+         * so an image may be given only once.
+         */
+        void image_ops_many(const std::vector<maz::ia::image*>& images,
+                            const std::vector<std::string>& op_names,
+                            size_t threads)
+        {
+            std::vector<image_op> ops;
+            for (const auto& name : op_names) ops.push_back(find_image_op(name));
+            std::set<const maz::ia::image*> seen;
+            for (const maz::ia::image* pimg : images) {
+                if (!seen.insert(pimg).second) throw std::invalid_argument("image_ops_many: the same image is given more than once");
+            }
+
+            py::gil_scoped_release release;
+            pylib::metrics_probe probe("image_ops_many");
+            pylib::parallel_for(images.size(), pylib::resolve_threads(threads), [&](size_t i) {
+                for (const auto& op : ops) op(*images[i]);
+            });
+        }
+
+    } // namespace
+
     void init_maz(py::module& m) 
     {
         // ============
@@ -30,8 +554,44 @@ namespace maz {
 
         // ============
 
+        m.def("metrics", []() { return pylib::metrics().to_py(); },
+            "Native per entry point counters: calls, total/mean/max seconds and log2(us) latency histogram");
+        m.def("metrics_reset", []() { pylib::metrics().reset(); },
+            "Zero all native counters");
+
+        // ============
+
+        py::register_exception<pylib::queue_full>(m, "QueueFull", py::module::import("asyncio").attr("QueueFull"));
+
+        py::class_<pylib::executor>(m, "executor")
+            .def(py::init<size_t, size_t>(), py::arg("threads") = 0, py::arg("max_queue") = 64,
+                "Native worker pool for the `*_submit` calls, submitting to a full queue raises `QueueFull`")
+            .def("pending", &pylib::executor::pending, "Queued jobs not yet picked up by a worker")
+            .def("threads", &pylib::executor::threads)
+            .def("max_queue", &pylib::executor::max_queue)
+            .def("shutdown", &pylib::executor::shutdown,
+                "Cancel queued jobs and wait for the running ones, the executor cannot be used afterwards");
+
+        // ============
+
+        m.def("fork_before", []() { pylib::fork_hooks().before(); },
+            "Take the native locks before fork() - see `os.register_at_fork`");
+        m.def("fork_after_parent", []() { pylib::fork_hooks().after_parent(); });
+        m.def("fork_after_child", []() { pylib::fork_hooks().after_child(); },
+            "Release the native locks and reset worker threads in the forked child");
+
+        m.def("set_threads", [](size_t threads) { pylib::default_threads() = threads; }, py::arg("threads"),
+            "Default worker count of the parallel batch calls, 0 means hardware concurrency");
+        m.def("get_threads", []() { return pylib::resolve_threads(0); },
+            "Effective default worker count of the parallel batch calls");
+
+        // ============
+
         py::class_<serial::i_to_json_dict>(m, "i_to_json_dict")
-            .def("to_json_str", &serial::i_to_json_dict::to_json_str, py::arg("full") = false, py::arg("indent") = -1);
+            .def("to_json_str", &serial::i_to_json_dict::to_json_str, py::arg("full") = false, py::arg("indent") = -1)
+            .def("to_py", [](serial::i_to_json_dict& self) -> py::object {
+                return pylib::js2object(self.to_json(serial::normal));
+            }, "Same as json.loads(to_json_str()) without the string");
 
 
 
@@ -78,6 +638,9 @@ namespace maz {
             .def_readwrite("text", &maz::doc::base_element::text)
             .def("conf", py::overload_cast<>(&maz::doc::base_element::conf, py::const_))
             .def("to_json_str", &serial::i_to_json_dict::to_json_str, py::arg("full") = false, py::arg("indent") = -1)
+            .def("to_py", [](maz::doc::word_type& self) -> py::object {
+                return pylib::js2object(self.to_json(serial::normal));
+            })
             .def_readwrite("detail", &maz::doc::word_type::detail)
         ;
 
@@ -87,10 +650,22 @@ namespace maz {
             .def("conf", py::overload_cast<>(&maz::doc::base_element::conf, py::const_))
             .def("words", &maz::doc::line_type::words)
             .def("__len__", &maz::doc::line_type::size)
-            .def("__getitem__", [](maz::doc::line_type& self, size_t i) -> maz::doc::ptr_word {
-                if (i >= self.size()) throw py::index_error();
-                return *std::next(self.begin(), i);
+            .def("__getitem__", [](const maz::doc::line_type& self, py::ssize_t i) -> maz::doc::ptr_word {
+                return *pylib::py_at(self, i);
             }, py::return_value_policy::reference_internal)
+            .def("__iter__", [](const maz::doc::line_type& self) {
+                return py::make_iterator(self.begin(), self.end());
+            }, py::keep_alive<0, 1>())
+            .def("indexed", [](const maz::doc::line_type& self) {
+                return pylib::indexed<maz::doc::line_type>(self);
+            }, py::keep_alive<0, 1>(), "O(1) indexing of the words while the line is not modified")
+        ;
+
+        py::class_<pylib::indexed<maz::doc::line_type>>(m, "line_indexed")
+            .def("__len__", &pylib::indexed<maz::doc::line_type>::size)
+            .def("__getitem__", [](const pylib::indexed<maz::doc::line_type>& self, py::ssize_t i) -> maz::doc::ptr_word {
+                return *self.at(i);
+            })
         ;
 
         py::class_<maz::doc::page_type, maz::doc::source_transformation>(m, "page")
@@ -101,9 +676,9 @@ namespace maz {
             .def("ia_keys", [](maz::doc::page_type& page) -> std::list<std::string> {
                 return page.ia_elems().keys();
             })
-            .def("ia_bboxes", [](maz::doc::page_type& page, const std::string& key) -> doc::bboxes_type {
-                if (!page.ia_elems().has(key)) return {};
-                return page.ia_elems().get(key)->bboxes();
+            .def("ia_bboxes", &page_ia_bboxes)
+            .def("ia_bboxes_array", [](maz::doc::page_type& page, const std::string& key) {
+                return bboxes_to_array(page_ia_bboxes(page, key));
             })
             .def("features", [](maz::doc::page_type& page) -> std::list<std::string> {
                 return page.features();
@@ -114,23 +689,49 @@ namespace maz {
             .def("info_keys", [](maz::doc::page_type& page) -> std::list<std::string> {
                 return page.get_info_keys();
             })
-            .def("hlines", [](maz::doc::page_type& page) -> doc::bboxes_type {
-                // get hlines from IA
-                if (!page.ia_elems().has("hlines")) return {};
-                return page.ia_elems().get("hlines")->bboxes();
+            .def("hlines", &page_hlines)
+            .def("vlines", &page_vlines)
+            .def("hlines_array", [](maz::doc::page_type& page) {
+                return bboxes_to_array(page_hlines(page));
             })
-            .def("vlines", [](maz::doc::page_type& page) -> doc::bboxes_type {
-                // get vlines only if table 
-                if (!page.ia_elems().has("table_bbox")) return {};
-                // form_ib.cpp:post_process:185
-                return page.ia_elems().get("vlines")->bboxes();
+            .def("vlines_array", [](maz::doc::page_type& page) {
+                return bboxes_to_array(page_vlines(page));
             })
+            .def("to_arrays", &page_to_arrays,
+                "Words as columns: bbox (N, 4), conf, line and word (positions in the page), "
+                "id (word ids - int64 array if numeric, list otherwise), orientation, "
+                "text_offsets (N + 1) into utf-8 `text` bytes, and line_bbox (L, 4)")
             .def("has_image", [](maz::doc::page_type& page, const std::string& key) -> bool {
                 return page.images().has(key);
             })
             .def("image_data_png_base64", [](maz::doc::page_type& page, const std::string& key) -> std::string {
                 return page.image_data(key).get<std::string>();
             })
+            .def("image_bytes", [](maz::doc::page_type& page, const std::string& key) -> py::bytes {
+                // decode into the bytes object directly
+                check_page_image(page, key);
+                auto&& js = page.image_data(key);
+                const std::string& b64 = js.get_ref<const std::string&>();
+                PyObject* pbytes = PyBytes_FromStringAndSize(nullptr, static_cast<py::ssize_t>(b64.size() / 4 * 3 + 3));
+                if (!pbytes) throw py::error_already_set();
+                size_t n = 0;
+                try {
+                    n = base64_decode(b64, reinterpret_cast<uint8_t*>(PyBytes_AS_STRING(pbytes)));
+                } catch (...) {
+                    Py_DECREF(pbytes);
+                    throw;
+                }
+                if (0 != _PyBytes_Resize(&pbytes, static_cast<py::ssize_t>(n))) throw py::error_already_set();
+                return py::reinterpret_steal<py::bytes>(pbytes);
+            }, "Raw (decoded) bytes of a stored page image")
+            .def("image", [](maz::doc::page_type& page, const std::string& key) {
+                check_page_image(page, key);
+                auto&& js = page.image_data(key);
+                const std::string& b64 = js.get_ref<const std::string&>();
+                std::vector<uint8_t> data(b64.size() / 4 * 3 + 3);
+                data.resize(base64_decode(b64, data.data()));
+                return new maz::ia::image(decode_pix(data.data(), data.size(), ""));
+            }, "Decoded stored page image")
             .def_readonly("bbox", &maz::doc::page_type::bbox)
 
             .def("mean_letter_h", [](maz::doc::page_type& self) -> double {
@@ -160,11 +761,51 @@ namespace maz {
                 [](maz::doc::document& doc) -> std::string {
                     return doc.to_json_str();
                 })
+            .def("to_bytes",
+                [](maz::doc::document& doc, const std::string& format) -> py::bytes {
+                    std::vector<uint8_t> buf;
+                    {
+                        py::gil_scoped_release release;
+                        buf = json_to_binary(doc.to_json(), format);
+                    }
+                    return py::bytes(reinterpret_cast<const char*>(buf.data()), buf.size());
+                }, py::arg("format") = "cbor",
+                "Serialize document as cbor or msgpack, same content as to_json_str")
+            .def("from_bytes",
+                [](maz::doc::document& doc, py::buffer buf, const std::string& format) {
+                    // parsed in place from the python buffer
+                    py::buffer_info info = buf.request();
+                    const uint8_t* data = contiguous_data(info);
+                    const size_t size = static_cast<size_t>(info.size * info.itemsize);
+                    py::gil_scoped_release release;
+                    serial::json_dict js = json_from_binary(data, size, format);
+                    doc.from_json(js);
+                }, py::arg("buf"), py::arg("format") = "cbor",
+                "Load document from to_bytes output (bytes, bytearray or memoryview)")
             .def("info_env", &maz::doc::document::info_env)
             .def("page_len", &maz::doc::document::page_count)
             .def("last_page", py::overload_cast<>(&maz::doc::document::last_page, py::const_), py::return_value_policy::reference)
         ;
 
+        py::class_<pylib::lazy_document>(m, "lazy_document")
+            .def(py::init<const maz_env_type&, const std::string&>(), py::arg("env"), py::arg("pages_key") = "pages")
+            .def("from_str", &pylib::lazy_document::from_str, py::call_guard<py::gil_scoped_release>(),
+                "Index pages of a document json, pages are parsed on access")
+            .def("from_file", &pylib::lazy_document::from_file, py::call_guard<py::gil_scoped_release>(),
+                "Index pages of a memory mapped document json file")
+            .def("page_len", &pylib::lazy_document::page_len)
+            .def("page", &pylib::lazy_document::page, py::return_value_policy::reference_internal,
+                py::call_guard<py::gil_scoped_release>())
+            .def("last_page", [](pylib::lazy_document& self) -> const maz::doc::page_type& {
+                if (0 == self.page_len()) throw py::index_error();
+                py::gil_scoped_release release;
+                return self.page(self.page_len() - 1);
+            }, py::return_value_policy::reference_internal)
+            .def("page_document", &pylib::lazy_document::page_document, py::return_value_policy::reference_internal,
+                py::call_guard<py::gil_scoped_release>(),
+                "Single page document of page i - for calls that need a document")
+        ;
+
         // ============    
 
         py::class_<maz::ia::image>(m, "image")
@@ -172,20 +813,63 @@ namespace maz {
             .def(py::init([](const std::string& buf, const std::string& type) {
                 return ia::image::base64_decode_copy(buf);
             }), py::arg("buf_base64"), py::arg("image_type"))
+            .def(py::init([](py::buffer buf, int bpp, int width, bool bgr) {
+                py::buffer_info info = buf.request();
+                return new maz::ia::image(buffer_to_pix(info, bpp, width, bgr));
+            }), py::arg("array"), py::arg("bpp") = 8, py::arg("width") = 0, py::arg("bgr") = true,
+                "Create image from a uint8 buffer - gray (h, w), colour (h, w, 3|4) or packed 1bpp (h, ceil(w/8)) with bpp=1")
+
+            .def("raster", [](maz::ia::image& self) -> py::array {
+                // the array keeps its own reference to the PIX, pixels outlive the image
+                PIX* pix = pixClone(self.raw());
+                py::capsule owner(pix, [](void* p) {
+                    PIX* pix_owned = static_cast<PIX*>(p);
+                    pixDestroy(&pix_owned);
+                });
+                const py::ssize_t h = pixGetHeight(pix);
+                const py::ssize_t wpl = pixGetWpl(pix);
+                return py::array_t<l_uint32>(
+                    {h, wpl}, {static_cast<py::ssize_t>(wpl * sizeof(l_uint32)), static_cast<py::ssize_t>(sizeof(l_uint32))},
+                    pixGetData(pix), owner);
+            },
+                "Raw leptonica raster - (h, wpl) native-endian 32bit words without copying. "
+                "Operations that replace the raster (e.g. `to8bpp`, `binarize_*`, `downscale2x`) "
+                "leave the array on the previous pixels")
+            .def_static("from_bytes", [](py::buffer buf, const std::string& format_hint) {
+                py::buffer_info info = buf.request();
+                const uint8_t* data = contiguous_data(info);
+                const size_t size = static_cast<size_t>(info.size * info.itemsize);
+                PIX* pix = nullptr;
+                {
+                    py::gil_scoped_release release;
+                    pix = decode_pix(data, size, format_hint);
+                }
+                return new maz::ia::image(pix);
+            }, py::arg("buf"), py::arg("format_hint") = "",
+                "Decode image from encoded bytes (png, tiff, jpeg, ...), e.g. bytes or a contiguous memoryview without copying")
+            .def("to_array", [](maz::ia::image& self, bool bgr) -> py::array {
+                return pix_to_array(self.raw(), bgr);
+            }, py::arg("bgr") = true,
+                "Copy pixels into a uint8 array in the layout accepted by the array constructor")
 
             .def("hash", &maz::ia::image::hash)
             .def("raw", &maz::ia::image::raw, py::return_value_policy::copy)
             .def("is_binary", &maz::ia::image::is_binary)
-            .def("to8bpp", &maz::ia::image::to8bpp, py::arg("fast") = true)
-            .def("deskew", &maz::ia::image::deskew)
-            .def("invert", &maz::ia::image::invert)
-            .def("binarize_otsu", &maz::ia::image::binarize_otsu)
-            .def("binarize_sauvola", &maz::ia::image::binarize_sauvola)
+            // pixel operations do not touch python objects
+            .def("to8bpp", &maz::ia::image::to8bpp, py::arg("fast") = true, py::call_guard<py::gil_scoped_release>())
+            .def("deskew", &maz::ia::image::deskew, py::call_guard<py::gil_scoped_release>())
+            .def("invert", &maz::ia::image::invert, py::call_guard<py::gil_scoped_release>())
+            .def("binarize_otsu", &maz::ia::image::binarize_otsu, py::call_guard<py::gil_scoped_release>())
+            .def("binarize_sauvola", &maz::ia::image::binarize_sauvola, py::call_guard<py::gil_scoped_release>())
             .def("clip", py::overload_cast<const maz::bbox_type&>(&maz::ia::image::clip, py::const_), py::return_value_policy::copy)
-            .def("downscale2x", &maz::ia::image::downscale2x)
-            .def("upscale2x", &maz::ia::image::upscale2x)
-            .def("enhance", &maz::ia::image::enhance)
+            .def("downscale2x", &maz::ia::image::downscale2x, py::call_guard<py::gil_scoped_release>())
+            .def("upscale2x", &maz::ia::image::upscale2x, py::call_guard<py::gil_scoped_release>())
+            .def("enhance", &maz::ia::image::enhance, py::call_guard<py::gil_scoped_release>())
             .def("bbox", &maz::ia::image::bbox)
+            .def("view", [](py::object self, const maz::bbox_type& bbox) {
+                return pylib::image_view(self, bbox);
+            }, py::arg("bbox"),
+                "Region of this image without copying pixels, accepted by the OCR calls, `ia_lines` and `ub04_classifier`")
             .def("base64_encode", &maz::ia::image::base64_encode)
 
             .def("__repr__", [](maz::ia::image& self) -> std::string {
@@ -194,6 +878,51 @@ namespace maz {
             })
             ;
 
+        m.def("image_ops_many", &image_ops_many,
+            py::arg("images"), py::arg("ops"), py::arg("threads") = 0,
+            "Apply in-place operations (e.g. [\"to8bpp\", \"binarize_sauvola\"]) in order to every image, "
+            "images run in parallel on `threads` workers (0 = `get_threads()`); results equal the serial calls");
+
+        py::class_<pylib::image_view>(m, "image_view")
+            .def(py::init<py::object, const maz::bbox_type&>(), py::arg("parent"), py::arg("bbox"))
+            .def("bbox", &pylib::image_view::bbox)
+            .def("parent", &pylib::image_view::parent)
+            .def("materialize", &pylib::image_view::materialize, py::call_guard<py::gil_scoped_release>(),
+                "Copy of the region as a new image")
+            .def("__repr__", [](const pylib::image_view& self) -> std::string {
+                return fmt::format("view:{} of bbox:{}", self.bbox().to_string(), self.image().bbox().to_string());
+            })
+            ;
+
+        py::class_<image_reader>(m, "image_reader")
+            .def(py::init<const std::string&, bool>(), py::arg("filename"), py::arg("prefetch") = true,
+                "Lazy page reader of a (multi-page tiff) image file kept memory mapped")
+            .def("__len__", &image_reader::size)
+            .def("__getitem__", [](image_reader& self, py::ssize_t i) {
+                const size_t idx = pylib::py_index(i, self.size());
+                PIX* pix = nullptr;
+                {
+                    py::gil_scoped_release release;
+                    pix = self.page(idx);
+                }
+                return new maz::ia::image(pix);
+            })
+            .def("__iter__", [](image_reader& self) -> image_reader& {
+                py::gil_scoped_release release;
+                self.rewind();
+                return self;
+            }, py::return_value_policy::reference_internal)
+            .def("__next__", [](image_reader& self) {
+                PIX* pix = nullptr;
+                {
+                    py::gil_scoped_release release;
+                    pix = self.next();
+                }
+                if (!pix) throw py::stop_iteration();
+                return new maz::ia::image(pix);
+            })
+            ;
+
         // ============
         py::class_<maz::la::cell_type, std::shared_ptr<maz::la::cell_type>>(m, "la_cell")
             .def("bbox", &maz::la::cell_type::bbox)
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "pylib_fork.h"
+
+#include <pybind11/pybind11.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace maz {
+namespace pylib {
+
+    /**
+     * Latency counters of one binding entry point, updated lock free.
+     * Bucket `i` counts calls shorter than 2^i microseconds, the last one
+     * everything longer.
+     */
+    struct metric
+    {
+        static constexpr size_t n_buckets = 24;
+
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        std::array<std::atomic<uint64_t>, n_buckets> buckets{};
+
+        void add(uint64_t ns)
+        {
+            calls.fetch_add(1, std::memory_order_relaxed);
+            total_ns.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t prev = max_ns.load(std::memory_order_relaxed);
+            while (prev < ns && !max_ns.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+            }
+            size_t b = 0;
+            for (uint64_t us = ns / 1000; 0 < us && b + 1 < n_buckets; us >>= 1) ++b;
+            buckets[b].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void reset()
+        {
+            calls = 0;
+            total_ns = 0;
+            max_ns = 0;
+            for (auto& b : buckets) b = 0;
+        }
+
+        pybind11::dict to_py() const
+        {
+            pybind11::dict d;
+            const uint64_t n = calls.load();
+            d["calls"] = n;
+            d["total_s"] = total_ns.load() / 1e9;
+            d["mean_s"] = (0 < n) ? total_ns.load() / 1e9 / n : 0.;
+            d["max_s"] = max_ns.load() / 1e9;
+            pybind11::list hist(n_buckets);
+            for (size_t i = 0; i < n_buckets; ++i) {
+                hist[i] = buckets[i].load();
+            }
+            d["histogram_log2_us"] = hist;
+            return d;
+        }
+    };
+
+    /** Process-wide named metrics, entries live until the module unloads. */
+    class metrics_registry
+    {
+    public:
+        metrics_registry() { fork_hooks().add_mutex(mtx_); }
+
+        metric& get(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            std::unique_ptr<metric>& pm = metrics_[name];
+            if (!pm) pm.reset(new metric());
+            return *pm;
+        }
+
+        pybind11::dict to_py() const
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            pybind11::dict d;
+            for (const auto& kv : metrics_) d[kv.first.c_str()] = kv.second->to_py();
+            return d;
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            for (auto& kv : metrics_) kv.second->reset();
+        }
+
+    private:
+        std::map<std::string, std::unique_ptr<metric>> metrics_;
+        mutable std::mutex mtx_;
+    };
+
+    inline metrics_registry& metrics()
+    {
+        // intentionally leaked, registered in the fork hooks and used by probes during teardown
+        static metrics_registry* pregistry = new metrics_registry();
+        return *pregistry;
+    }
+
+    /** Adds the duration of its scope to metric `name`. */
+    class metrics_probe
+    {
+    public:
+        explicit metrics_probe(const char* name)
+            : metric_(metrics().get(name)), start_(std::chrono::steady_clock::now()) {}
+
+        metrics_probe(const metrics_probe&) = delete;
+        metrics_probe& operator=(const metrics_probe&) = delete;
+
+        ~metrics_probe()
+        {
+            const auto took = std::chrono::steady_clock::now() - start_;
+            metric_.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(took).count()));
+        }
+
+    private:
+        metric& metric_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+} // namespace pylib
+} // namespace maz
@@ -6,10 +6,37 @@
 #undef HAVE_FSTATAT
 #endif
 
+#include "format/format.h"
 #include "ocr/engines.h"
 #include "ocr/processing.h"
 #include "ocr/reocr.h"
 
+#include "pylib_executor.h"
+#include "pylib_fork.h"
+#include "pylib_image_view.h"
+#include "pylib_io.h"
+#include "pylib_json.h"
+#include "pylib_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace py = pybind11;
 
 // ================
@@ -17,81 +44,1255 @@ namespace py = pybind11;
 // clang-format off
 namespace maz {
 
+    namespace {
+
+        using ocr_result = std::tuple<std::string, maz::doc::words_type>;
+
+        /** Named phase durations [s] in the order they were recorded. */
+        using timing_type = std::vector<std::pair<std::string, double>>;
+
+        py::dict timing_to_py(const timing_type& timing)
+        {
+            py::dict d;
+            for (const auto& kv : timing) d[kv.first.c_str()] = kv.second;
+            return d;
+        }
+
+        double seconds_since(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        /**
+         * `ocr-params` of a `maz.v5.json` like config - the `default` and `reocr`
+         * engine environments with values formatted like python `str()`.
+         */
+        struct ocr_params
+        {
+            maz_env_type default_env;
+            maz_env_type reocr_env;
+
+            explicit ocr_params(const std::string& config_path)
+            {
+                pylib::mapped_file f(config_path);
+                const char* data = reinterpret_cast<const char*>(f.data());
+                const serial::json_impl js = serial::json_impl::parse(data, data + f.size());
+                const serial::json_impl& params = js.at("ocr-params");
+                fill(params.at("default"), default_env);
+                fill(params.at("reocr"), reocr_env);
+            }
+
+        private:
+            static void fill(const serial::json_impl& js, maz_env_type& env)
+            {
+                for (auto it = js.begin(); it != js.end(); ++it) env[it.key()] = pylib::py_str(it.value());
+            }
+        };
+
+        /**
+         * Initialize every (engine manager, default|reocr) engine one after
+         * another - engine init is not known to be thread safe. Each engine gets
+         * its own copy of the environment; the config is read once.
+         */
+        timing_type init_engines(const std::vector<maz::ocr::engine_manager*>& managers,
+                                 const std::string& config_path, const std::string& lang_dir,
+                                 const std::string& default_data, const std::string& reocr_data)
+        {
+            timing_type timing;
+            const auto start = std::chrono::steady_clock::now();
+            const ocr_params params(config_path);
+            timing.emplace_back("read_config", seconds_since(start));
+
+            double default_sum = 0., reocr_sum = 0.;
+            const auto start_init = std::chrono::steady_clock::now();
+            for (maz::ocr::engine_manager* pmgr : managers) {
+                auto start_engine = std::chrono::steady_clock::now();
+                maz_env_type env_ocr(params.default_env);
+                pmgr->ocr().init(lang_dir, default_data, env_ocr);
+                default_sum += seconds_since(start_engine);
+
+                start_engine = std::chrono::steady_clock::now();
+                maz_env_type env_reocr(params.reocr_env);
+                pmgr->reocr().init(lang_dir, reocr_data, env_reocr);
+                reocr_sum += seconds_since(start_engine);
+            }
+            timing.emplace_back("init_engines", seconds_since(start_init));
+            timing.emplace_back("init_default", default_sum);
+            timing.emplace_back("init_reocr", reocr_sum);
+            timing.emplace_back("total", seconds_since(start));
+            return timing;
+        }
+
+        /**
+         * Owns `size` initialized engine managers and hands them out one per call
+         * so that python threads can run recognition concurrently.
+         */
+        class engine_pool
+        {
+        public:
+            /** Engine manager borrowed from the pool, returned on destruction. */
+            class lease
+            {
+            public:
+                lease(engine_pool& pool, maz::ocr::engine_manager* pmgr)
+                    : pool_(&pool), pmgr_(pmgr) {}
+                lease(lease&& other) noexcept
+                    : pool_(other.pool_), pmgr_(other.pmgr_) { other.pmgr_ = nullptr; }
+                lease(const lease&) = delete;
+                lease& operator=(const lease&) = delete;
+                ~lease() { if (pmgr_) pool_->release(pmgr_); }
+
+                maz::ocr::engine& get(bool use_reocr) {
+                    return use_reocr ? pmgr_->reocr() : pmgr_->ocr();
+                }
+
+            private:
+                engine_pool* pool_;
+                maz::ocr::engine_manager* pmgr_;
+            };
+
+            engine_pool(const std::string& default_name, const std::string& reocr_name, size_t size)
+            {
+                if (0 == size) throw std::invalid_argument("ocr engine pool size must be positive");
+                for (size_t i = 0; i < size; ++i) {
+                    managers_.emplace_back(new maz::ocr::engine_manager(default_name, reocr_name));
+                    idle_.push_back(managers_.back().get());
+                }
+                // engines leased by other threads at fork time stay unavailable in the child
+                fork_id_ = pylib::fork_hooks().add(
+                    [this]() { mtx_.lock(); },
+                    [this]() { mtx_.unlock(); },
+                    [this]() {
+                        new (&cv_) std::condition_variable();
+                        mtx_.unlock();
+                    });
+            }
+
+            engine_pool(const engine_pool&) = delete;
+            engine_pool& operator=(const engine_pool&) = delete;
+
+            ~engine_pool() { pylib::fork_hooks().remove(fork_id_); }
+
+            void init(const std::string& lang_dir,
+                      const std::string& default_data, const maz_env_type& default_env,
+                      const std::string& reocr_data, const maz_env_type& reocr_env)
+            {
+                for (auto& pmgr : managers_) {
+                    // engines may adjust the env they were given
+                    maz_env_type env_ocr(default_env);
+                    pmgr->ocr().init(lang_dir, default_data, env_ocr);
+                    maz_env_type env_reocr(reocr_env);
+                    pmgr->reocr().init(lang_dir, reocr_data, env_reocr);
+                }
+            }
+
+            timing_type init_all(const std::string& config_path, const std::string& lang_dir,
+                                 const std::string& default_data, const std::string& reocr_data)
+            {
+                std::vector<maz::ocr::engine_manager*> managers;
+                for (auto& pmgr : managers_) managers.push_back(pmgr.get());
+                return init_engines(managers, config_path, lang_dir, default_data, reocr_data);
+            }
+
+            /** Blocks until an engine manager is idle - call without the GIL. */
+            lease acquire()
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] { return !idle_.empty(); });
+                maz::ocr::engine_manager* pmgr = idle_.back();
+                idle_.pop_back();
+                return lease(*this, pmgr);
+            }
+
+            size_t size() const { return managers_.size(); }
+
+            size_t available() const
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                return idle_.size();
+            }
+
+        private:
+            void release(maz::ocr::engine_manager* pmgr)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    idle_.push_back(pmgr);
+                }
+                cv_.notify_one();
+            }
+
+            std::vector<std::unique_ptr<maz::ocr::engine_manager>> managers_;
+            std::vector<maz::ocr::engine_manager*> idle_;
+            mutable std::mutex mtx_;
+            std::condition_variable cv_;
+            size_t fork_id_ = 0;
+        };
+
+        /**
+         * Mutex per bare engine (one not leased from an `engine_pool`). Such an
+         * engine may be shared by python threads and recognition runs without
+         * the GIL, so calls on one engine are serialized here while different
+         * engines still run in parallel.
+         */
+        class engine_locks
+        {
+        public:
+            engine_locks()
+            {
+                // owners of engine locks at fork time do not exist in the child
+                pylib::fork_hooks().add(
+                    [this]() { mtx_.lock(); },
+                    [this]() { mtx_.unlock(); },
+                    [this]() {
+                        for (auto& kv : locks_) new (kv.second.get()) std::mutex();
+                        mtx_.unlock();
+                    });
+            }
+
+            std::mutex& get(const maz::ocr::engine& engine)
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                std::unique_ptr<std::mutex>& pmtx = locks_[&engine];
+                if (!pmtx) pmtx.reset(new std::mutex());
+                return *pmtx;
+            }
+
+        private:
+            std::mutex mtx_;
+            std::map<const maz::ocr::engine*, std::unique_ptr<std::mutex>> locks_;
+        };
+
+        engine_locks& bare_engine_locks()
+        {
+            // intentionally leaked, registered in the fork hooks
+            static engine_locks* plocks = new engine_locks();
+            return *plocks;
+        }
+
+        /** Exclusive use of a bare engine - call without the GIL. */
+        std::unique_lock<std::mutex> lock_engine(const maz::ocr::engine& engine)
+        {
+            return std::unique_lock<std::mutex>(bare_engine_locks().get(engine));
+        }
+
+        using engine_pair_lock = std::pair<std::unique_lock<std::mutex>, std::unique_lock<std::mutex>>;
+
+        /** Exclusive use of two bare engines (e.g. of one manager) - call without the GIL. */
+        engine_pair_lock lock_engines(const maz::ocr::engine& first, const maz::ocr::engine& second)
+        {
+            std::unique_lock<std::mutex> lock_first(bare_engine_locks().get(first), std::defer_lock);
+            std::unique_lock<std::mutex> lock_second(bare_engine_locks().get(second), std::defer_lock);
+            std::lock(lock_first, lock_second);
+            return engine_pair_lock(std::move(lock_first), std::move(lock_second));
+        }
+
+        /** Bind an engine method so that it waits for (and holds) the engine lock without the GIL. */
+        template <typename R, typename... Args>
+        std::function<R(maz::ocr::engine&, Args...)> engine_locked(R (maz::ocr::engine::*fn)(Args...))
+        {
+            return [fn](maz::ocr::engine& self, Args... args) -> R {
+                py::gil_scoped_release release;
+                auto lock = lock_engine(self);
+                return (self.*fn)(std::forward<Args>(args)...);
+            };
+        }
+
+        template <typename R, typename... Args>
+        std::function<R(maz::ocr::engine&, Args...)> engine_locked(R (maz::ocr::engine::*fn)(Args...) const)
+        {
+            return [fn](maz::ocr::engine& self, Args... args) -> R {
+                py::gil_scoped_release release;
+                auto lock = lock_engine(self);
+                return (self.*fn)(std::forward<Args>(args)...);
+            };
+        }
+
+        /** Deep copy so that callers do not share mutable words. */
+        ocr_result copy_result(const ocr_result& res)
+        {
+            maz::doc::words_type words;
+            for (const auto& pw : std::get<1>(res)) {
+                words.push_back(std::make_shared<doc::word_type>(*pw));
+            }
+            return ocr_result(std::get<0>(res), words);
+        }
+
+        /**
+         * Statistics accumulated by the OCR calls given the same `stats` object.
+         * `native` is the engine side `run_stats` passed to `ocr::processing`;
+         * its fields are not part of this layer so only the counters measured
+         * here are exposed.
+         */
+        struct ocr_stats
+        {
+            maz::ocr::run_stats native;
+            uint64_t calls = 0;
+            uint64_t words = 0;
+            uint64_t empty = 0;
+            double total_s = 0.;
+            double max_s = 0.;
+
+            void add(const ocr_result& res, double took_s)
+            {
+                ++calls;
+                words += std::get<1>(res).size();
+                if (std::get<1>(res).empty()) ++empty;
+                total_s += took_s;
+                max_s = std::max(max_s, took_s);
+            }
+
+            /** Counters of `other` (e.g. of a worker thread), `native` is not merged. */
+            void merge(const ocr_stats& other)
+            {
+                calls += other.calls;
+                words += other.words;
+                empty += other.empty;
+                total_s += other.total_s;
+                max_s = std::max(max_s, other.max_s);
+            }
+
+            py::dict to_py() const
+            {
+                py::dict d;
+                d["calls"] = calls;
+                d["words"] = words;
+                d["empty"] = empty;
+                d["total_s"] = total_s;
+                d["mean_s"] = 0 < calls ? total_s / calls : 0.;
+                d["max_s"] = max_s;
+                return d;
+            }
+        };
+
+        /** Time `recognise(run_stats&)` into `*pstats` (when given). */
+        template <typename fn_type>
+        ocr_result counted(ocr_stats* pstats, fn_type recognise)
+        {
+            ocr_stats local_stats;
+            ocr_stats& stats = pstats ? *pstats : local_stats;
+            const auto start = std::chrono::steady_clock::now();
+            ocr_result res = recognise(stats.native);
+            stats.add(res, seconds_since(start));
+            return res;
+        }
+
+        /**
+         * Bounded LRU of OCR results keyed by image hash, engine, data version,
+         * mode and bbox. Disabled (max_entries 0) by default.
+         */
+        class ocr_cache
+        {
+        public:
+            ocr_cache() { pylib::fork_hooks().add_mutex(mtx_); }
+
+            void configure(size_t max_entries, size_t max_bytes)
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                max_entries_ = max_entries;
+                max_bytes_ = max_bytes;
+                enabled_ = (0 < max_entries);
+                shrink();
+            }
+
+            bool enabled() const { return enabled_; }
+
+            bool get(const std::string& key, ocr_result& res)
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                auto it = idx_.find(key);
+                if (it == idx_.end()) {
+                    ++misses_;
+                    return false;
+                }
+                ++hits_;
+                lru_.splice(lru_.begin(), lru_, it->second);
+                res = copy_result(it->second->res);
+                return true;
+            }
+
+            void put(const std::string& key, const ocr_result& res)
+            {
+                entry e{key, copy_result(res), size_of(key, res)};
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (!enabled_ || idx_.count(key)) return;
+                bytes_ += e.bytes;
+                lru_.push_front(std::move(e));
+                idx_[key] = lru_.begin();
+                shrink();
+            }
+
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                lru_.clear();
+                idx_.clear();
+                bytes_ = 0;
+            }
+
+            py::dict stats() const
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                py::dict d;
+                d["hits"] = hits_;
+                d["misses"] = misses_;
+                d["evictions"] = evictions_;
+                d["entries"] = lru_.size();
+                d["bytes"] = bytes_;
+                d["max_entries"] = max_entries_;
+                d["max_bytes"] = max_bytes_;
+                return d;
+            }
+
+        private:
+            struct entry
+            {
+                std::string key;
+                ocr_result res;
+                size_t bytes;
+            };
+
+            static size_t size_of(const std::string& key, const ocr_result& res)
+            {
+                size_t n = sizeof(entry) + key.size() + std::get<0>(res).size();
+                for (const auto& pw : std::get<1>(res)) n += sizeof(doc::word_type) + pw->text.size();
+                return n;
+            }
+
+            void shrink()
+            {
+                while (!lru_.empty() && (lru_.size() > max_entries_ || (0 < max_bytes_ && bytes_ > max_bytes_))) {
+                    bytes_ -= lru_.back().bytes;
+                    idx_.erase(lru_.back().key);
+                    lru_.pop_back();
+                    ++evictions_;
+                }
+            }
+
+            mutable std::mutex mtx_;
+            std::atomic<bool> enabled_{false};
+            size_t max_entries_ = 0;
+            size_t max_bytes_ = 0;
+            std::list<entry> lru_;
+            std::unordered_map<std::string, std::list<entry>::iterator> idx_;
+            size_t bytes_ = 0;
+            size_t hits_ = 0;
+            size_t misses_ = 0;
+            size_t evictions_ = 0;
+        };
+
+        ocr_cache& result_cache()
+        {
+            // intentionally leaked, registered in the fork hooks
+            static ocr_cache* pcache = new ocr_cache();
+            return *pcache;
+        }
+
+        /**
+         * Image part of the cache key - "" when the cache is disabled so the
+         * image is not hashed.
+         */
+        std::string cache_image_key(const maz::ia::image& img)
+        {
+            if (!result_cache().enabled()) return "";
+            return fmt::format("{}", img.hash());
+        }
+
+        /**
+         * Image part of a reOCR cache key - the word region with a margin of one
+         * bbox height (context `prepare_image` may look at) is hashed instead of
+         * the whole page, reOCR runs once per word.
+         */
+        std::string cache_region_key(const maz::ia::image& page_img, const doc::bbox_type& bbox)
+        {
+            if (!result_cache().enabled()) return "";
+            const double margin = bbox.height();
+            const maz::bbox_type ib = page_img.bbox();
+            const maz::bbox_type area(
+                std::max(bbox.xlt() - margin, ib.xlt()), std::max(bbox.ylt() - margin, ib.ylt()),
+                std::min(bbox.xrb() + margin, ib.xrb()), std::min(bbox.yrb() + margin, ib.yrb()));
+            // nothing to recognise, not worth caching
+            if (area.width() <= 0 || area.height() <= 0) return "";
+            return fmt::format("{}|{}", area.to_string(), page_img.clip(area).hash());
+        }
+
+        /** Run `recognise` unless the cache has the result, nothing is cached for an empty `img_key`. */
+        template <typename fn_type>
+        ocr_result with_cache(const char* mode, maz::ocr::engine& engine, const std::string& img_key,
+                              const std::string& extra, fn_type recognise)
+        {
+            if (img_key.empty()) return recognise();
+
+            ocr_cache& cache = result_cache();
+            const std::string key = fmt::format("{}|{}|{}|{}|{}",
+                mode, img_key, engine.name(), engine.data_version(), extra);
+            ocr_result res;
+            if (cache.get(key, res)) return res;
+            res = recognise();
+            cache.put(key, res);
+            return res;
+        }
+
+        // ============
+        // recognition helpers - called without the GIL
+
+        /**
+         * Typical text height [px] - median length of the runs of rows that
+         * contain ink, on a column sample. Rules are not text: sampled columns
+         * inked in most rows (vertical rules) are skipped and rows with a long
+         * horizontal ink run (rules, underlines) end a run. 0 when unknown
+         * (unsupported depth, colormap or no text).
+         */
+        int estimate_letter_h(PIX* pix)
+        {
+            const int d = pixGetDepth(pix);
+            if (pixGetColormap(pix) || (1 != d && 8 != d && 32 != d)) return 0;
+            const int w = pixGetWidth(pix);
+            const int h = pixGetHeight(pix);
+            const int wpl = pixGetWpl(pix);
+            const l_uint32* data = pixGetData(pix);
+            const int step = std::max(1, w / 512);
+            const int min_ink = std::max(1, (w / step) / 200);
+            const int min_rule_w = std::max(w / 4, 64);
+
+            auto is_ink = [d](const l_uint32* line, int x) {
+                if (1 == d) return 0 != GET_DATA_BIT(line, x);
+                if (8 == d) return GET_DATA_BYTE(line, x) < 128;
+                return static_cast<int>((line[x] >> L_GREEN_SHIFT) & 0xff) < 128;
+            };
+
+            // vertical rules
+            const int n_cols = (w + step - 1) / step;
+            std::vector<int> col_ink(n_cols, 0);
+            for (int y = 0; y < h; ++y) {
+                const l_uint32* line = data + y * wpl;
+                for (int c = 0; c < n_cols; ++c) col_ink[c] += is_ink(line, c * step) ? 1 : 0;
+            }
+            std::vector<char> text_col(n_cols);
+            for (int c = 0; c < n_cols; ++c) text_col[c] = (4 * col_ink[c] <= 3 * h) ? 1 : 0;
+
+            std::vector<int> runs;
+            int run = 0;
+            for (int y = 0; y <= h; ++y) {
+                int ink = 0;
+                bool rule = false;
+                if (y < h) {
+                    const l_uint32* line = data + y * wpl;
+                    int ink_w = 0;
+                    for (int c = 0; c < n_cols && !rule; ++c) {
+                        if (!is_ink(line, c * step)) {
+                            ink_w = 0;
+                            continue;
+                        }
+                        ink_w += step;
+                        rule = (ink_w >= min_rule_w);
+                        if (text_col[c]) ++ink;
+                    }
+                }
+                if (!rule && ink >= min_ink) {
+                    ++run;
+                } else {
+                    // shorter runs are rules or noise
+                    if (3 <= run) runs.push_back(run);
+                    run = 0;
+                }
+            }
+            if (runs.empty()) return 0;
+            std::nth_element(runs.begin(), runs.begin() + runs.size() / 2, runs.end());
+            return runs[runs.size() / 2];
+        }
+
+        // positions recognised on an image downscaled by `f` mapped back to the source
+
+        template <typename T>
+        typename std::enable_if<std::is_arithmetic<T>::value>::type scale_up(T& v, int f)
+        {
+            v = static_cast<T>(v * f);
+        }
+
+        /** Inclusive corners - the last small pixel covers `f` source pixels. */
+        void scale_up(doc::bbox_type& b, int f)
+        {
+            b = doc::bbox_type(b.xlt() * f, b.ylt() * f, (b.xrb() + 1) * f - 1, (b.yrb() + 1) * f - 1);
+        }
+
+        template <typename A, typename B>
+        void scale_up(std::pair<A, B>& p, int f);
+
+        template <typename T>
+        void scale_up(std::vector<T>& values, int f)
+        {
+            for (auto& v : values) scale_up(v, f);
+        }
+
+        template <typename A, typename B>
+        void scale_up(std::pair<A, B>& p, int f)
+        {
+            scale_up(p.first, f);
+            scale_up(p.second, f);
+        }
+
+        /**
+         * Opt-in resolution normalization: with `target_letter_h` > 0 the image
+         * is halved (the source is not modified) while its text stays at least
+         * that high, then `recognise(img)` runs there and word bboxes and
+         * baselines are scaled back by the same power of two.
+         */
+        template <typename fn_type>
+        ocr_result with_letter_h(maz::ia::image& img, int target_letter_h, fn_type recognise)
+        {
+            if (target_letter_h <= 0) return recognise(img);
+
+            std::unique_ptr<maz::ia::image> psmall;
+            int factor = 1;
+            {
+                pylib::metrics_probe probe("ocr_rescale");
+                const int letter_h = estimate_letter_h(img.raw());
+                while (0 < letter_h && letter_h / (2 * factor) >= target_letter_h) factor *= 2;
+                if (1 < factor) {
+                    // shares the pixels, each downscale2x replaces them with a new raster
+                    psmall.reset(new maz::ia::image(img));
+                    for (int f = 1; f < factor; f *= 2) psmall->downscale2x();
+                }
+            }
+            if (!psmall) return recognise(img);
+
+            ocr_result res = recognise(*psmall);
+            for (auto& pw : std::get<1>(res)) {
+                scale_up(pw->bbox, factor);
+                scale_up(pw->detail.baseline, factor);
+            }
+            return res;
+        }
+
+        ocr_result ocr_line_impl(maz::ocr::engine& engine, maz::ia::image& img, ocr_stats* pstats)
+        {
+            pylib::metrics_probe probe("ocr_line");
+            return counted(pstats, [&](maz::ocr::run_stats& runstats) {
+                return with_cache("ocr_line", engine, cache_image_key(img), "", [&]() {
+                    maz::doc::words_type words;
+                    std::string s = maz::ocr::ocr_line(engine, runstats, words, img, "pyocr:ocr_line");
+                    return ocr_result(s, words);
+                });
+            });
+        }
+
+        /** reOCR of one word, cached by its region of the page. */
+        ocr_result reocr_impl(maz::ocr::engine& engine, ocr_stats* pstats,
+                              const maz::ia::image& page_img, const doc::bbox_type& word_bbox, bool raw)
+        {
+            pylib::metrics_probe probe("reocr");
+            const std::string region_key = cache_region_key(page_img, word_bbox);
+            const std::string extra = region_key.empty() ? std::string() : fmt::format("{}|{}", word_bbox.to_string(), raw);
+            return counted(pstats, [&](maz::ocr::run_stats& runstats) {
+                return with_cache("reocr", engine, region_key, extra, [&]() {
+                    maz::doc::words_type words;
+                    std::string s;
+
+                    doc::ptr_word pwtmp(new doc::word_type("", {"", ""}));
+                    std::list<std::string> tags;
+                    bool one_simple_line = true;
+
+                    std::shared_ptr<segment::word> pwi = ocr::reocr::prepare_image(
+                        page_img, word_bbox, pwtmp, tags, one_simple_line);
+                    if (!pwi) return ocr_result(s, words);
+
+                    s = maz::ocr::ocr_line(engine, runstats, words, *pwi, "pyocr:reocr", raw);
+                    return ocr_result(s, words);
+                });
+            });
+        }
+
+        /**
+         * reOCR all bboxes against one page image; each distinct bbox is recognised
+         * once, `threads` workers each borrow their own engine via `get_engine`.
+         */
+        template <typename engine_getter>
+        std::vector<ocr_result> reocr_many_impl(engine_getter get_engine,
+                                                size_t threads,
+                                                const maz::ia::image& page_img,
+                                                const std::vector<doc::bbox_type>& bboxes,
+                                                bool raw,
+                                                ocr_stats* pstats)
+        {
+            std::vector<ocr_result> results(bboxes.size());
+
+            // the same word is often requested several times (v3 pass, retries)
+            using bbox_key = std::tuple<double, double, double, double>;
+            std::map<bbox_key, size_t> first_idx;
+            std::vector<size_t> todo;
+            std::vector<size_t> same_as(bboxes.size());
+            for (size_t i = 0; i < bboxes.size(); ++i) {
+                const doc::bbox_type& b = bboxes[i];
+                auto it = first_idx.emplace(bbox_key(b.xlt(), b.ylt(), b.xrb(), b.yrb()), i);
+                same_as[i] = it.first->second;
+                if (it.second) todo.push_back(i);
+            }
+
+            std::atomic<size_t> next(0);
+            std::exception_ptr perr;
+            std::mutex mtx;
+            auto worker = [&]() {
+                ocr_stats local_stats;
+                try {
+                    auto l = get_engine();
+                    for (size_t j = next++; j < todo.size(); j = next++) {
+                        size_t i = todo[j];
+                        results[i] = reocr_impl(l.get(true), &local_stats, page_img, bboxes[i], raw);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (!perr) perr = std::current_exception();
+                    next = todo.size();
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                if (pstats) pstats->merge(local_stats);
+            };
+
+            threads = std::max<size_t>(1, std::min(threads, todo.size()));
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < threads; ++t) workers.emplace_back(worker);
+            worker();
+            for (auto& w : workers) w.join();
+            if (perr) std::rethrow_exception(perr);
+
+            for (size_t i = 0; i < bboxes.size(); ++i) {
+                if (same_as[i] != i) results[i] = copy_result(results[same_as[i]]);
+            }
+            return results;
+        }
+
+        /** Lease-like wrapper so a single (locked) engine fits `reocr_many_impl`. */
+        struct engine_ref
+        {
+            maz::ocr::engine& engine;
+            std::unique_lock<std::mutex> lock;
+            maz::ocr::engine& get(bool) { return engine; }
+        };
+
+        ocr_result ocr_word_impl(maz::ocr::engine& engine, maz::ia::image& img, ocr_stats* pstats)
+        {
+            pylib::metrics_probe probe("ocr_word");
+            return counted(pstats, [&](maz::ocr::run_stats& runstats) {
+                return with_cache("ocr_word", engine, cache_image_key(img), "", [&]() {
+                    maz::doc::words_type words;
+                    std::string s = maz::ocr::ocr_word(engine, runstats, words, img, "pyocr:ocr_word");
+                    return ocr_result(s, words);
+                });
+            });
+        }
+
+        ocr_result ocr_block_impl(maz::ocr::engine& engine, maz::ia::image& img, ocr_stats* pstats)
+        {
+            pylib::metrics_probe probe("ocr_block");
+            return counted(pstats, [&](maz::ocr::run_stats& runstats) {
+                return with_cache("ocr_block", engine, cache_image_key(img), "", [&]() {
+                    maz::doc::words_type words;
+                    std::string s = maz::ocr::ocr_block(engine, runstats, words, img, "pyocr:ocr_block");
+                    return ocr_result(s, words);
+                });
+            });
+        }
+
+        /** Process-wide counters of `ocr_cascade` - how much reOCR work was avoided. */
+        struct cascade_counters
+        {
+            std::atomic<uint64_t> lines{0};
+            std::atomic<uint64_t> words{0};
+            std::atomic<uint64_t> low_conf{0};
+            std::atomic<uint64_t> unknown{0};
+            std::atomic<uint64_t> reocr_words{0};
+            std::atomic<uint64_t> replaced{0};
+
+            void reset()
+            {
+                lines = 0;
+                words = 0;
+                low_conf = 0;
+                unknown = 0;
+                reocr_words = 0;
+                replaced = 0;
+            }
+
+            py::dict to_py() const
+            {
+                py::dict d;
+                const uint64_t n = words.load();
+                d["lines"] = lines.load();
+                d["words"] = n;
+                d["low_conf"] = low_conf.load();
+                d["unknown"] = unknown.load();
+                d["reocr_words"] = reocr_words.load();
+                d["replaced"] = replaced.load();
+                d["reocr_avoided"] = n - reocr_words.load();
+                return d;
+            }
+        };
+
+        cascade_counters& cascade_stats()
+        {
+            static cascade_counters counters;
+            return counters;
+        }
+
+        /**
+         * Line OCR with the fast `ocr` engine, only words below `min_conf` (or
+         * not in the dictionary when `check_dict`) are reOCRed with the `reocr`
+         * engine through `reocr::prepare_image`. A word takes the reOCR text
+         * when its confidence is higher. Confidences are compared on a [0, 1]
+         * scale - `fast_scale`/`reocr_scale` is what each engine reports for full
+         * confidence (fixed per engine, a result cannot tell percents of a bad
+         * line from fractions). A replaced word keeps the fast engine's scale.
+         */
+        ocr_result ocr_cascade_impl(maz::ocr::engine& fast, maz::ocr::engine& exact,
+                                    maz::ia::image& img, double min_conf, bool check_dict,
+                                    double fast_scale, double reocr_scale)
+        {
+            if (fast_scale <= 0. || reocr_scale <= 0.) throw std::invalid_argument("confidence scales must be positive");
+            pylib::metrics_probe probe("ocr_cascade");
+            cascade_counters& counters = cascade_stats();
+
+            ocr_result res = ocr_line_impl(fast, img, nullptr);
+            maz::doc::words_type& words = std::get<1>(res);
+            ++counters.lines;
+            counters.words += words.size();
+
+            bool changed = false;
+            for (auto& pw : words) {
+                const double fast_conf = pw->conf() / fast_scale;
+                const bool low_conf = fast_conf < min_conf;
+                const bool unknown = !low_conf && check_dict &&
+                                     !fast.known_word(pw->text) && !fast.known_userdict_word(pw->text);
+                if (!low_conf && !unknown) continue;
+                ++(low_conf ? counters.low_conf : counters.unknown);
+                ++counters.reocr_words;
+
+                ocr_result re = reocr_impl(exact, nullptr, img, pw->bbox, false);
+                const maz::doc::words_type& re_words = std::get<1>(re);
+                if (re_words.empty()) continue;
+                double conf = 0.;
+                for (const auto& prw : re_words) conf += prw->conf();
+                conf /= re_words.size() * reocr_scale;
+                if (conf <= fast_conf) continue;
+
+                std::string text;
+                for (const auto& prw : re_words) text += (text.empty() ? "" : " ") + prw->text;
+                pw->text = text;
+                pw->conf(conf * fast_scale);
+                ++counters.replaced;
+                changed = true;
+            }
+
+            if (changed) {
+                std::string s;
+                for (const auto& pw : words) s += (s.empty() ? "" : " ") + pw->text;
+                std::get<0>(res) = s;
+            }
+            return res;
+        }
+
+        /**
+         * `name(engine|pool, image_view, ...)` overloads of a word/block
+         * recognizer - only the view region is copied for the engine.
+         */
+        template <typename impl_fn>
+        void def_view_overloads(py::module& m, const char* name, impl_fn impl)
+        {
+            m.def(name,
+                [impl](maz::ocr::engine& engine, const pylib::image_view& view, ocr_stats* pstats, int target_letter_h) {
+                    py::gil_scoped_release release;
+                    maz::ia::image img = view.materialize();
+                    auto lock = lock_engine(engine);
+                    return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                        return impl(engine, img_ocr, pstats);
+                    });
+                },
+                py::arg("engine"), py::arg("img"), py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
+                "OCR image view");
+
+            m.def(name,
+                [impl](engine_pool& pool, const pylib::image_view& view, bool use_reocr, ocr_stats* pstats, int target_letter_h) {
+                    py::gil_scoped_release release;
+                    maz::ia::image img = view.materialize();
+                    engine_pool::lease l = pool.acquire();
+                    return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                        return impl(l.get(use_reocr), img_ocr, pstats);
+                    });
+                },
+                py::arg("pool"), py::arg("img"), py::arg("reocr") = false, py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
+                "OCR image view using an engine from the pool");
+        }
+
+    } // namespace
+
     void init_ocr(py::module& m) 
     {
         py::class_<maz::ocr::engine>(m, "ocr_engine")
             .def("name", &maz::ocr::engine::name)
             .def("image", &maz::ocr::engine::image)
-            .def("recognize", &maz::ocr::engine::recognise)
-            .def("init", &maz::ocr::engine::init)
+            // calls changing the engine state wait for OCR running on it in other threads
+            .def("recognize", engine_locked(&maz::ocr::engine::recognise))
+            .def("init", engine_locked(&maz::ocr::engine::init))
             .def("data_version", &maz::ocr::engine::data_version)
             .def("version", &maz::ocr::engine::version)
             .def("known_word", &maz::ocr::engine::known_word)
             .def("known_userdict_word", &maz::ocr::engine::known_userdict_word)
-            .def("adjust_for_text_word", &maz::ocr::engine::adjust_for_text_word)
-            .def("adjust_for_text_line", &maz::ocr::engine::adjust_for_text_line)
-            .def("adjust_for_page", &maz::ocr::engine::adjust_for_page);
+            .def("adjust_for_text_word", engine_locked(&maz::ocr::engine::adjust_for_text_word))
+            .def("adjust_for_text_line", engine_locked(&maz::ocr::engine::adjust_for_text_line))
+            .def("adjust_for_page", engine_locked(&maz::ocr::engine::adjust_for_page));
 
         // ============
 
+        m.def("ocr_params", [](const std::string& config_path) {
+                const ocr_params params(config_path);
+                auto to_py = [](const maz_env_type& env) {
+                    py::dict d;
+                    for (const auto& kv : env) d[py::str(kv.first)] = kv.second;
+                    return d;
+                };
+                return py::make_tuple(to_py(params.default_env), to_py(params.reocr_env));
+            }, py::arg("config_path"),
+            "(default, reocr) engine parameters of a config json as `init_all` passes them to the engines");
+
         py::class_<maz::ocr::engine_manager>(m, "ocr_engine_manager")
             .def(py::init<const std::string&, const std::string&>(), py::arg("default"), py::arg("reocr"))
             .def("ocr", static_cast<maz::ocr::engine& (maz::ocr::engine_manager::*)()>(&maz::ocr::engine_manager::ocr), py::return_value_policy::reference_internal)
-            .def("reocr", static_cast<maz::ocr::engine& (maz::ocr::engine_manager::*)()>(&maz::ocr::engine_manager::reocr), py::return_value_policy::reference_internal);
+            .def("reocr", static_cast<maz::ocr::engine& (maz::ocr::engine_manager::*)()>(&maz::ocr::engine_manager::reocr), py::return_value_policy::reference_internal)
+            .def("init_all",
+                [](maz::ocr::engine_manager& self, const std::string& config_path, const std::string& lang_dir,
+                   const std::string& default_data, const std::string& reocr_data) {
+                    timing_type timing;
+                    {
+                        py::gil_scoped_release release;
+                        auto locks = lock_engines(self.ocr(), self.reocr());
+                        timing = init_engines({&self}, config_path, lang_dir, default_data, reocr_data);
+                    }
+                    return timing_to_py(timing);
+                },
+                py::arg("config_path"), py::arg("lang_dir"), py::arg("default_data") = "maz", py::arg("reocr_data") = "maz-lstm",
+                "Initialize both engines one after another from the `ocr-params` of a config json, returns startup timing [s]");
+
+        py::class_<engine_pool>(m, "ocr_engine_pool")
+            .def(py::init<const std::string&, const std::string&, size_t>(), py::arg("default"), py::arg("reocr"), py::arg("size"))
+            .def("init", &engine_pool::init,
+                py::arg("lang_dir"), py::arg("default_data"), py::arg("default_env"), py::arg("reocr_data"), py::arg("reocr_env"),
+                py::call_guard<py::gil_scoped_release>())
+            .def("init_all",
+                [](engine_pool& self, const std::string& config_path, const std::string& lang_dir,
+                   const std::string& default_data, const std::string& reocr_data) {
+                    timing_type timing;
+                    {
+                        py::gil_scoped_release release;
+                        timing = self.init_all(config_path, lang_dir, default_data, reocr_data);
+                    }
+                    return timing_to_py(timing);
+                },
+                py::arg("config_path"), py::arg("lang_dir"), py::arg("default_data") = "maz", py::arg("reocr_data") = "maz-lstm",
+                "Initialize all pooled engines one after another from the `ocr-params` of a config json, returns startup timing [s]")
+            .def("available", &engine_pool::available)
+            .def("__len__", &engine_pool::size);
+
+        // `stats` passed to the OCR calls accumulates over calls, do not share
+        // one between threads (`reocr_many` merges its workers' stats itself)
+        py::class_<ocr_stats>(m, "ocr_run_stats")
+            .def(py::init<>())
+            .def_readonly("calls", &ocr_stats::calls)
+            .def_readonly("words", &ocr_stats::words)
+            .def_readonly("empty", &ocr_stats::empty)
+            .def_readonly("total_s", &ocr_stats::total_s)
+            .def_readonly("max_s", &ocr_stats::max_s)
+            .def("to_py", &ocr_stats::to_py, "Counters as dict, with mean_s")
+            .def("__repr__", [](const ocr_stats& self) -> std::string {
+                return fmt::format("calls:{} words:{} empty:{} total:{:.4f}s max:{:.4f}s",
+                    self.calls, self.words, self.empty, self.total_s, self.max_s);
+            });
 
         // ============
+        // recognition releases the GIL; calls on one bare engine are serialized
+        // by its lock, python threads OCR in parallel with different engines
+        // (or an `ocr_engine_pool`)
 
         m.def(
             "ocr_line",
-            [](maz::ocr::engine& engine, maz::ia::image& img, bool raw) {
-                maz::ocr::run_stats runstats;
-                maz::doc::words_type words;
-                std::string s = maz::ocr::ocr_line(engine, runstats, words, img, "pyocr:ocr_line");
-                return make_tuple(s, words);
+            [](maz::ocr::engine& engine, maz::ia::image& img, bool raw, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                auto lock = lock_engine(engine);
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_line_impl(engine, img_ocr, pstats);
+                });
             },
+            py::arg("engine"), py::arg("img"), py::arg("raw"), py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
             "OCR line image");
 
+        m.def(
+            "ocr_line",
+            [](engine_pool& pool, maz::ia::image& img, bool raw, bool use_reocr, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                engine_pool::lease l = pool.acquire();
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_line_impl(l.get(use_reocr), img_ocr, pstats);
+                });
+            },
+            py::arg("pool"), py::arg("img"), py::arg("raw"), py::arg("reocr") = false, py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
+            "OCR line image using an engine from the pool");
+
         m.def(
             "reocr",
-            [](maz::ocr::engine& engine, const maz::ia::image& page_img, doc::bbox_type word_bbox, bool raw) {
-                maz::ocr::run_stats runstats;
-                maz::doc::words_type words;
-                std::string s;
+            [](maz::ocr::engine& engine, const maz::ia::image& page_img, doc::bbox_type word_bbox, bool raw, ocr_stats* pstats) {
+                py::gil_scoped_release release;
+                auto lock = lock_engine(engine);
+                return reocr_impl(engine, pstats, page_img, word_bbox, raw);
+            },
+            py::arg("engine"), py::arg("page_img"), py::arg("word_bbox"), py::arg("raw"), py::arg("stats") = nullptr,
+            "reOCR line image");
 
-                doc::ptr_word pwtmp(new doc::word_type("", {"", ""}));
-                std::list<std::string> tags;
-                bool one_simple_line = true;
+        m.def(
+            "reocr",
+            [](engine_pool& pool, const maz::ia::image& page_img, doc::bbox_type word_bbox, bool raw, ocr_stats* pstats) {
+                py::gil_scoped_release release;
+                engine_pool::lease l = pool.acquire();
+                return reocr_impl(l.get(true), pstats, page_img, word_bbox, raw);
+            },
+            py::arg("pool"), py::arg("page_img"), py::arg("word_bbox"), py::arg("raw"), py::arg("stats") = nullptr,
+            "reOCR line image using a reocr engine from the pool");
 
-                std::shared_ptr<segment::word> pwi = ocr::reocr::prepare_image(
-                    page_img, word_bbox, pwtmp, tags, one_simple_line);
-                if (!pwi) return make_tuple(s, words);
+        // the view is the page image and the word bbox, nothing is copied
+        m.def(
+            "reocr",
+            [](maz::ocr::engine& engine, const pylib::image_view& view, bool raw, ocr_stats* pstats) {
+                py::gil_scoped_release release;
+                auto lock = lock_engine(engine);
+                return reocr_impl(engine, pstats, view.image(), view.bbox(), raw);
+            },
+            py::arg("engine"), py::arg("view"), py::arg("raw"), py::arg("stats") = nullptr,
+            "reOCR the region of an image view");
 
-                s = maz::ocr::ocr_line(engine, runstats, words, *pwi, "pyocr:reocr", raw);
-                return make_tuple(s, words);
+        m.def(
+            "reocr",
+            [](engine_pool& pool, const pylib::image_view& view, bool raw, ocr_stats* pstats) {
+                py::gil_scoped_release release;
+                engine_pool::lease l = pool.acquire();
+                return reocr_impl(l.get(true), pstats, view.image(), view.bbox(), raw);
             },
-            "reOCR line image");
+            py::arg("pool"), py::arg("view"), py::arg("raw"), py::arg("stats") = nullptr,
+            "reOCR the region of an image view using a reocr engine from the pool");
+
+        m.def(
+            "reocr_many",
+            [](maz::ocr::engine& engine, const maz::ia::image& page_img, const std::vector<doc::bbox_type>& bboxes, bool raw, ocr_stats* pstats) {
+                py::gil_scoped_release release;
+                pylib::metrics_probe probe("reocr_many");
+                return reocr_many_impl([&engine]() { return engine_ref{engine, lock_engine(engine)}; }, 1, page_img, bboxes, raw, pstats);
+            },
+            py::arg("engine"), py::arg("page_img"), py::arg("bboxes"), py::arg("raw") = false, py::arg("stats") = nullptr,
+            "reOCR all bboxes of a page image in one call, returns list of (text, words)");
+
+        m.def(
+            "reocr_many",
+            [](engine_pool& pool, const maz::ia::image& page_img, const std::vector<doc::bbox_type>& bboxes, bool raw, size_t threads, ocr_stats* pstats) {
+                py::gil_scoped_release release;
+                pylib::metrics_probe probe("reocr_many");
+                if (0 == threads) threads = pool.size();
+                return reocr_many_impl([&pool]() { return pool.acquire(); }, threads, page_img, bboxes, raw, pstats);
+            },
+            py::arg("pool"), py::arg("page_img"), py::arg("bboxes"), py::arg("raw") = false, py::arg("threads") = 0, py::arg("stats") = nullptr,
+            "reOCR all bboxes of a page image spread over engines from the pool (threads=0 uses the pool size)");
+
+        m.def(
+            "ocr_cascade",
+            [](maz::ocr::engine_manager& mgr, maz::ia::image& img, double min_conf, bool check_dict,
+               double fast_scale, double reocr_scale) {
+                py::gil_scoped_release release;
+                auto locks = lock_engines(mgr.ocr(), mgr.reocr());
+                return ocr_cascade_impl(mgr.ocr(), mgr.reocr(), img, min_conf, check_dict, fast_scale, reocr_scale);
+            },
+            py::arg("manager"), py::arg("img"), py::arg("min_conf"), py::arg("check_dict") = true,
+            py::arg("fast_scale") = 100., py::arg("reocr_scale") = 100.,
+            "OCR line with the fast engine, reOCR only words with confidence below `min_conf` (on a [0, 1] scale, "
+            "engine confidences are divided by `fast_scale`/`reocr_scale`) or unknown to the dictionary; returns (text, words)");
+
+        m.def(
+            "ocr_cascade",
+            [](engine_pool& pool, maz::ia::image& img, double min_conf, bool check_dict,
+               double fast_scale, double reocr_scale) {
+                py::gil_scoped_release release;
+                engine_pool::lease l = pool.acquire();
+                return ocr_cascade_impl(l.get(false), l.get(true), img, min_conf, check_dict, fast_scale, reocr_scale);
+            },
+            py::arg("pool"), py::arg("img"), py::arg("min_conf"), py::arg("check_dict") = true,
+            py::arg("fast_scale") = 100., py::arg("reocr_scale") = 100.,
+            "`ocr_cascade` using an engine pair from the pool");
 
+        m.def("ocr_cascade_stats", []() { return cascade_stats().to_py(); },
+            "Cascade counters: lines, words, low_conf/unknown words sent to reOCR, replaced and reocr_avoided");
+        m.def("ocr_cascade_stats_reset", []() { cascade_stats().reset(); });
 
         m.def(
             "ocr_word",
-            [](maz::ocr::engine& engine, maz::ia::image& img) {
-                maz::ocr::run_stats runstats;
-                maz::doc::words_type words;
-                std::string s = maz::ocr::ocr_word(engine, runstats, words, img, "pyocr:ocr_word");
-                return make_tuple(s, words);
+            [](maz::ocr::engine& engine, maz::ia::image& img, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                auto lock = lock_engine(engine);
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_word_impl(engine, img_ocr, pstats);
+                });
             },
+            py::arg("engine"), py::arg("img"), py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
             "OCR word image");
 
+        m.def(
+            "ocr_word",
+            [](engine_pool& pool, maz::ia::image& img, bool use_reocr, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                engine_pool::lease l = pool.acquire();
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_word_impl(l.get(use_reocr), img_ocr, pstats);
+                });
+            },
+            py::arg("pool"), py::arg("img"), py::arg("reocr") = false, py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
+            "OCR word image using an engine from the pool");
+
         m.def(
             "ocr_block",
-            [](maz::ocr::engine& engine, maz::ia::image& img) {
-                maz::ocr::run_stats runstats;
-                maz::doc::words_type words;
-                std::string s = maz::ocr::ocr_block(engine, runstats, words, img, "pyocr:ocr_block");
-                return make_tuple(s, words);
+            [](maz::ocr::engine& engine, maz::ia::image& img, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                auto lock = lock_engine(engine);
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_block_impl(engine, img_ocr, pstats);
+                });
             },
+            py::arg("engine"), py::arg("img"), py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
             "OCR block image");
 
+        m.def(
+            "ocr_block",
+            [](engine_pool& pool, maz::ia::image& img, bool use_reocr, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                engine_pool::lease l = pool.acquire();
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_block_impl(l.get(use_reocr), img_ocr, pstats);
+                });
+            },
+            py::arg("pool"), py::arg("img"), py::arg("reocr") = false, py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
+            "OCR block image using an engine from the pool");
+
+        m.def(
+            "ocr_line",
+            [](maz::ocr::engine& engine, const pylib::image_view& view, bool raw, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                maz::ia::image img = view.materialize();
+                auto lock = lock_engine(engine);
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_line_impl(engine, img_ocr, pstats);
+                });
+            },
+            py::arg("engine"), py::arg("img"), py::arg("raw"), py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
+            "OCR line image view");
+
+        m.def(
+            "ocr_line",
+            [](engine_pool& pool, const pylib::image_view& view, bool raw, bool use_reocr, ocr_stats* pstats, int target_letter_h) {
+                py::gil_scoped_release release;
+                maz::ia::image img = view.materialize();
+                engine_pool::lease l = pool.acquire();
+                return with_letter_h(img, target_letter_h, [&](maz::ia::image& img_ocr) {
+                    return ocr_line_impl(l.get(use_reocr), img_ocr, pstats);
+                });
+            },
+            py::arg("pool"), py::arg("img"), py::arg("raw"), py::arg("reocr") = false, py::arg("stats") = nullptr, py::arg("target_letter_h") = 0,
+            "OCR line image view using an engine from the pool");
+
+        def_view_overloads(m, "ocr_word", &ocr_word_impl);
+        def_view_overloads(m, "ocr_block", &ocr_block_impl);
+
+        // ============
+        // asyncio variants - queued to a native `executor`, an engine is borrowed
+        // from the pool when a worker picks the job up
+
+        m.def(
+            "ocr_line_submit",
+            [](pylib::executor& ex, py::object pool_obj, py::object img_obj, bool use_reocr) {
+                engine_pool& pool = pool_obj.cast<engine_pool&>();
+                maz::ia::image& img = img_obj.cast<maz::ia::image&>();
+                return ex.submit_value([&pool, &img, use_reocr]() {
+                    engine_pool::lease l = pool.acquire();
+                    return ocr_line_impl(l.get(use_reocr), img, nullptr);
+                }, py::make_tuple(pool_obj, img_obj));
+            },
+            py::arg("executor"), py::arg("pool"), py::arg("img"), py::arg("reocr") = false,
+            "Queue `ocr_line`, returns asyncio future of (text, words)");
+
+        m.def(
+            "ocr_word_submit",
+            [](pylib::executor& ex, py::object pool_obj, py::object img_obj, bool use_reocr) {
+                engine_pool& pool = pool_obj.cast<engine_pool&>();
+                maz::ia::image& img = img_obj.cast<maz::ia::image&>();
+                return ex.submit_value([&pool, &img, use_reocr]() {
+                    engine_pool::lease l = pool.acquire();
+                    return ocr_word_impl(l.get(use_reocr), img, nullptr);
+                }, py::make_tuple(pool_obj, img_obj));
+            },
+            py::arg("executor"), py::arg("pool"), py::arg("img"), py::arg("reocr") = false,
+            "Queue `ocr_word`, returns asyncio future of (text, words)");
+
+        m.def(
+            "ocr_block_submit",
+            [](pylib::executor& ex, py::object pool_obj, py::object img_obj, bool use_reocr) {
+                engine_pool& pool = pool_obj.cast<engine_pool&>();
+                maz::ia::image& img = img_obj.cast<maz::ia::image&>();
+                return ex.submit_value([&pool, &img, use_reocr]() {
+                    engine_pool::lease l = pool.acquire();
+                    return ocr_block_impl(l.get(use_reocr), img, nullptr);
+                }, py::make_tuple(pool_obj, img_obj));
+            },
+            py::arg("executor"), py::arg("pool"), py::arg("img"), py::arg("reocr") = false,
+            "Queue `ocr_block`, returns asyncio future of (text, words)");
+
+        m.def(
+            "reocr_submit",
+            [](pylib::executor& ex, py::object pool_obj, py::object page_img_obj, doc::bbox_type word_bbox, bool raw) {
+                engine_pool& pool = pool_obj.cast<engine_pool&>();
+                const maz::ia::image& page_img = page_img_obj.cast<const maz::ia::image&>();
+                return ex.submit_value([&pool, &page_img, word_bbox, raw]() {
+                    engine_pool::lease l = pool.acquire();
+                    return reocr_impl(l.get(true), nullptr, page_img, word_bbox, raw);
+                }, py::make_tuple(pool_obj, page_img_obj));
+            },
+            py::arg("executor"), py::arg("pool"), py::arg("page_img"), py::arg("word_bbox"), py::arg("raw") = false,
+            "Queue `reocr`, returns asyncio future of (text, words)");
+
+        m.def(
+            "reocr_many_submit",
+            [](pylib::executor& ex, py::object pool_obj, py::object page_img_obj, const std::vector<doc::bbox_type>& bboxes, bool raw) {
+                engine_pool& pool = pool_obj.cast<engine_pool&>();
+                const maz::ia::image& page_img = page_img_obj.cast<const maz::ia::image&>();
+                return ex.submit_value([&pool, &page_img, bboxes, raw]() {
+                    pylib::metrics_probe probe("reocr_many");
+                    return reocr_many_impl([&pool]() { return pool.acquire(); }, 1, page_img, bboxes, raw, nullptr);
+                }, py::make_tuple(pool_obj, page_img_obj));
+            },
+            py::arg("executor"), py::arg("pool"), py::arg("page_img"), py::arg("bboxes"), py::arg("raw") = false,
+            "Queue `reocr_many` (one worker per job), returns asyncio future of list of (text, words)");
+
+        // ============
+
+        m.def(
+            "ocr_cache_configure",
+            [](size_t max_entries, size_t max_bytes) {
+                result_cache().configure(max_entries, max_bytes);
+            },
+            py::arg("max_entries"), py::arg("max_bytes") = 0,
+            "Enable OCR result cache (max_entries 0 disables it, max_bytes 0 means no memory cap)");
+
+        m.def(
+            "ocr_cache_stats",
+            []() { return result_cache().stats(); },
+            "OCR result cache counters");
+
+        m.def(
+            "ocr_cache_clear",
+            []() { result_cache().clear(); },
+            "Drop all cached OCR results");
+
     }
 
 } // namespace maz
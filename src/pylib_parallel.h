@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace maz {
+namespace pylib {
+
+    /** Process-wide default worker count, 0 means hardware concurrency. */
+    inline std::atomic<size_t>& default_threads()
+    {
+        static std::atomic<size_t> threads(0);
+        return threads;
+    }
+
+    /** Effective worker count for a per call request (0 = process default). */
+    inline size_t resolve_threads(size_t threads)
+    {
+        if (0 == threads) threads = default_threads().load();
+        if (0 == threads) threads = std::thread::hardware_concurrency();
+        return std::max<size_t>(1, threads);
+    }
+
+    /**
+     * Run `fn(i)` for i in [0, n) on up to `threads` threads (the calling one
+     * included). The first exception stops the remaining work and is rethrown.
+     */
+    template <typename F>
+    void parallel_for(size_t n, size_t threads, F&& fn)
+    {
+        std::atomic<size_t> next(0);
+        std::exception_ptr perr;
+        std::mutex err_mtx;
+        auto worker = [&]() {
+            try {
+                for (size_t i = next++; i < n; i = next++) fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(err_mtx);
+                if (!perr) perr = std::current_exception();
+                next = n;
+            }
+        };
+
+        threads = std::max<size_t>(1, std::min(threads, n));
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; ++t) workers.emplace_back(worker);
+        worker();
+        for (auto& w : workers) w.join();
+        if (perr) std::rethrow_exception(perr);
+    }
+
+} // namespace pylib
+} // namespace maz